@@ -0,0 +1,26 @@
+#ifndef Z80EMU_BENCH_MACHINE_HPP
+#define Z80EMU_BENCH_MACHINE_HPP
+
+#include "cpu.hpp"
+#include "bus/simulated_bus.hpp"
+
+// A Cpu on the simulated bus with a register state that keeps block instructions to one iteration.
+class BenchMachine {
+public:
+    SimulatedBus bus;
+    Cpu cpu{&bus};
+
+    void prepare(){
+        // B for the block I/O instructions, C for their port
+        this->cpu.registers.bc(0x0101);
+        this->cpu.registers.de(0x9000);
+        this->cpu.registers.hl(0x8800);
+        this->cpu.special_registers.ix = 0x8000;
+        this->cpu.special_registers.iy = 0x8000;
+        this->cpu.special_registers.sp = 0xf000;
+        this->cpu.special_registers.pc = 0x0100;
+        this->cpu.halt = false;
+    }
+};
+
+#endif //Z80EMU_BENCH_MACHINE_HPP
@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+#include "bench_machine.hpp"
+
+// The flag helpers through the register instructions that use them. Nothing but the
+// instruction is fetched, so each case is the helper plus the opcode dispatch.
+
+static void BM_SetFlagsByAddition(benchmark::State& state){
+    BenchMachine machine;
+    machine.cpu.registers.b = 0x5a;
+    for (auto _ : state){
+        // add a,b
+        machine.cpu.opCode.execute(0x80);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsBySubtract(benchmark::State& state){
+    BenchMachine machine;
+    machine.cpu.registers.b = 0x5a;
+    for (auto _ : state){
+        // sub b
+        machine.cpu.opCode.execute(0x90);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByIncrement(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        // inc a
+        machine.cpu.opCode.execute(0x3c);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByDecrement(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        // dec a
+        machine.cpu.opCode.execute(0x3d);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsBySbc16(benchmark::State& state){
+    BenchMachine machine;
+    machine.cpu.registers.bc(0x1234);
+    for (auto _ : state){
+        // sbc hl,bc
+        machine.cpu.opCode.executeEd(0x42);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByLogical(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        // and b, with a new B each time
+        machine.cpu.opCode.execute(0xa0);
+        machine.cpu.registers.b++;
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByAdd16(benchmark::State& state){
+    BenchMachine machine;
+    machine.cpu.registers.bc(0x1234);
+    for (auto _ : state){
+        // add hl,bc
+        machine.cpu.opCode.execute(0x09);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByAdc16(benchmark::State& state){
+    BenchMachine machine;
+    machine.cpu.registers.bc(0x1234);
+    for (auto _ : state){
+        // adc hl,bc
+        machine.cpu.opCode.executeEd(0x4a);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_SetFlagsByRotate(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        // rlc a
+        machine.cpu.opCode.executeCb(0x07);
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_SetFlagsByAddition);
+BENCHMARK(BM_SetFlagsBySubtract);
+BENCHMARK(BM_SetFlagsByIncrement);
+BENCHMARK(BM_SetFlagsByDecrement);
+BENCHMARK(BM_SetFlagsBySbc16);
+BENCHMARK(BM_SetFlagsByLogical);
+BENCHMARK(BM_SetFlagsByAdd16);
+BENCHMARK(BM_SetFlagsByAdc16);
+BENCHMARK(BM_SetFlagsByRotate);
@@ -0,0 +1,28 @@
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "bench_machine.hpp"
+
+// Short loops that do work every pass, which idle detection has to rule out.
+// Argument: idle detection off (0) or on (1).
+static void stepLoop(benchmark::State& state, const std::vector<uint8_t>& program){
+    BenchMachine machine;
+    machine.cpu.enable_virtual_memory = true;
+    machine.cpu.setPinPolling(0);
+    for (size_t i = 0; i < program.size(); i++){
+        machine.cpu.memory(0x0100 + i) = program[i];
+    }
+    machine.prepare();
+    machine.cpu.setIdleDetection(state.range(0) != 0);
+    for (auto _ : state){
+        machine.cpu.step();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// ld b,0 / inc a / djnz $-1 / jr $-7
+static void BM_IdleRegisterLoop(benchmark::State& state){ stepLoop(state, {0x06, 0x00, 0x3c, 0x10, 0xfd, 0x18, 0xf9}); }
+// ld b,0 / ld (hl),a / inc hl / djnz $-2 / jr $-8
+static void BM_IdleMemoryLoop(benchmark::State& state){ stepLoop(state, {0x06, 0x00, 0x77, 0x23, 0x10, 0xfc, 0x18, 0xf8}); }
+
+BENCHMARK(BM_IdleRegisterLoop)->Arg(0)->Arg(1);
+BENCHMARK(BM_IdleMemoryLoop)->Arg(0)->Arg(1);
@@ -0,0 +1,63 @@
+#include <fstream>
+#include <benchmark/benchmark.h>
+#include "bench_machine.hpp"
+#include "log.hpp"
+
+// Cost paid at every Log call site, without and with a log file attached.
+
+class LogMachine : public BenchMachine {
+public:
+    std::ofstream log{"log.txt"};
+
+    LogMachine(){
+        this->cpu.log_sink = &this->log;
+    }
+};
+
+static void BM_LogDisabled(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        Log::execute(&machine.cpu, 0x00, "nop");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LogExecute(benchmark::State& state){
+    LogMachine machine;
+    for (auto _ : state){
+        Log::execute(&machine.cpu, 0x00, "nop");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LogMemRead(benchmark::State& state){
+    LogMachine machine;
+    uint16_t addr = 0;
+    for (auto _ : state){
+        Log::mem_read(&machine.cpu, addr, 0x00);
+        addr++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LogTargetRegister(benchmark::State& state){
+    LogMachine machine;
+    for (auto _ : state){
+        Log::target_register(&machine.cpu, "a");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LogDumpRegisters(benchmark::State& state){
+    LogMachine machine;
+    for (auto _ : state){
+        Log::dump_registers(&machine.cpu);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_LogDisabled);
+BENCHMARK(BM_LogExecute);
+BENCHMARK(BM_LogMemRead);
+BENCHMARK(BM_LogTargetRegister);
+BENCHMARK(BM_LogDumpRegisters);
@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+#include "bench_machine.hpp"
+#include "mcycle.hpp"
+
+static void BM_McycleM1(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        Mcycle::m1t1(&machine.cpu);
+        Mcycle::m1t2(&machine.cpu);
+        Mcycle::m1t3(&machine.cpu);
+        Mcycle::m1t4(&machine.cpu);
+        benchmark::DoNotOptimize(machine.cpu.executing);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_McycleM1t1(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        Mcycle::m1t1(&machine.cpu);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_McycleM1t3(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        Mcycle::m1t3(&machine.cpu);
+        benchmark::DoNotOptimize(machine.cpu.executing);
+    }
+}
+
+static void BM_McycleM1t4(benchmark::State& state){
+    BenchMachine machine;
+    for (auto _ : state){
+        Mcycle::m1t4(&machine.cpu);
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_McycleM2(benchmark::State& state){
+    BenchMachine machine;
+    uint16_t addr = 0;
+    for (auto _ : state){
+        benchmark::DoNotOptimize(Mcycle::m2(&machine.cpu, addr));
+        addr++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_McycleM3(benchmark::State& state){
+    BenchMachine machine;
+    uint16_t addr = 0;
+    for (auto _ : state){
+        Mcycle::m3(&machine.cpu, addr, (uint8_t)addr);
+        addr++;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_McycleIn(benchmark::State& state){
+    BenchMachine machine;
+    uint8_t port = 0;
+    for (auto _ : state){
+        benchmark::DoNotOptimize(Mcycle::in(&machine.cpu, port, 0));
+        port++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_McycleOut(benchmark::State& state){
+    BenchMachine machine;
+    uint8_t port = 0;
+    for (auto _ : state){
+        Mcycle::out(&machine.cpu, port, 0, port);
+        port++;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_McycleM1);
+BENCHMARK(BM_McycleM1t1);
+BENCHMARK(BM_McycleM1t3);
+BENCHMARK(BM_McycleM1t4);
+BENCHMARK(BM_McycleM2);
+BENCHMARK(BM_McycleM3);
+BENCHMARK(BM_McycleIn);
+BENCHMARK(BM_McycleOut);
@@ -0,0 +1,70 @@
+#include <stdexcept>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "bench_machine.hpp"
+
+// Places the bytes following the first opcode at PC and returns the first opcode.
+static uint8_t load(BenchMachine& machine, const std::vector<uint8_t>& prefix, uint8_t op){
+    if (prefix.empty()){
+        return op;
+    }
+    if (prefix[0] == 0xed && (op & 0xf6) == 0xb0){
+        // LDIR, CPIR, LDDR and CPDR count BC, which would make 257 passes
+        machine.cpu.registers.bc(0x0001);
+    }
+    uint16_t addr = machine.cpu.special_registers.pc;
+    if (prefix.size() == 2){
+        // XX CB d op
+        machine.bus.memory[addr++] = prefix[1];
+        machine.bus.memory[addr++] = 0x00;
+    }
+    machine.bus.memory[addr] = op;
+    return prefix[0];
+}
+
+// Opcodes of one prefix space that the emulator implements.
+static std::vector<uint8_t> validOpcodes(BenchMachine& machine, const std::vector<uint8_t>& prefix){
+    std::vector<uint8_t> opcodes;
+    for (int op = 0; op <= 0xff; op++){
+        machine.prepare();
+        try {
+            machine.cpu.opCode.execute(load(machine, prefix, op));
+            opcodes.push_back(op);
+        } catch (std::runtime_error&){
+        }
+    }
+    return opcodes;
+}
+
+static void dispatch(benchmark::State& state, const std::vector<uint8_t>& prefix){
+    BenchMachine machine;
+    std::vector<uint8_t> opcodes = validOpcodes(machine, prefix);
+
+    size_t i = 0;
+    for (auto _ : state){
+        machine.prepare();
+        machine.cpu.opCode.execute(load(machine, prefix, opcodes[i]));
+        benchmark::ClobberMemory();
+        if (++i == opcodes.size()){
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["opcodes"] = (double)opcodes.size();
+}
+
+static void BM_DispatchUnprefixed(benchmark::State& state){ dispatch(state, {}); }
+static void BM_DispatchCb(benchmark::State& state){ dispatch(state, {0xcb}); }
+static void BM_DispatchDd(benchmark::State& state){ dispatch(state, {0xdd}); }
+static void BM_DispatchEd(benchmark::State& state){ dispatch(state, {0xed}); }
+static void BM_DispatchFd(benchmark::State& state){ dispatch(state, {0xfd}); }
+static void BM_DispatchDdCb(benchmark::State& state){ dispatch(state, {0xdd, 0xcb}); }
+static void BM_DispatchFdCb(benchmark::State& state){ dispatch(state, {0xfd, 0xcb}); }
+
+BENCHMARK(BM_DispatchUnprefixed);
+BENCHMARK(BM_DispatchCb);
+BENCHMARK(BM_DispatchDd);
+BENCHMARK(BM_DispatchEd);
+BENCHMARK(BM_DispatchFd);
+BENCHMARK(BM_DispatchDdCb);
+BENCHMARK(BM_DispatchFdCb);
@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+#include "registers.hpp"
+#include "special_registers.hpp"
+
+static void BM_RegistersPairRead(benchmark::State& state){
+    Registers registers;
+    registers.bc(0x1234);
+    registers.de(0x5678);
+    registers.hl(0x9abc);
+    for (auto _ : state){
+        benchmark::DoNotOptimize(registers.bc());
+        benchmark::DoNotOptimize(registers.de());
+        benchmark::DoNotOptimize(registers.hl());
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+
+static void BM_RegistersPairWrite(benchmark::State& state){
+    Registers registers;
+    uint16_t value = 0;
+    for (auto _ : state){
+        registers.bc(value);
+        registers.de(value + 1);
+        registers.hl(value + 2);
+        value++;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+
+static void BM_RegistersAf(benchmark::State& state){
+    Registers registers;
+    uint16_t value = 0;
+    for (auto _ : state){
+        registers.af(value);
+        benchmark::DoNotOptimize(registers.af());
+        value++;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+static void BM_SpecialRegistersIndexHalves(benchmark::State& state){
+    SpecialRegisters special_registers;
+    uint8_t value = 0;
+    for (auto _ : state){
+        special_registers.ixh(value);
+        special_registers.ixl(value + 1);
+        special_registers.iyh(value + 2);
+        special_registers.iyl(value + 3);
+        benchmark::DoNotOptimize(special_registers.ixh());
+        benchmark::DoNotOptimize(special_registers.ixl());
+        benchmark::DoNotOptimize(special_registers.iyh());
+        benchmark::DoNotOptimize(special_registers.iyl());
+        value++;
+    }
+    state.SetItemsProcessed(state.iterations() * 8);
+}
+
+BENCHMARK(BM_RegistersPairRead);
+BENCHMARK(BM_RegistersPairWrite);
+BENCHMARK(BM_RegistersAf);
+BENCHMARK(BM_SpecialRegistersIndexHalves);
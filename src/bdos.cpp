@@ -0,0 +1,681 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "bdos.hpp"
+#include "cpu.hpp"
+#include "mcycle.hpp"
+
+static const size_t FILE_BUFFER_SIZE = 64 * 1024;
+
+// FCB offsets
+static const uint8_t FCB_DRIVE = 0;
+static const uint8_t FCB_NAME = 1;
+static const uint8_t FCB_EX = 12;
+static const uint8_t FCB_S1 = 13;
+static const uint8_t FCB_S2 = 14;
+static const uint8_t FCB_RC = 15;
+static const uint8_t FCB_CR = 32;
+static const uint8_t FCB_R0 = 33;
+
+// "FOO.COM" -> "FOO     COM". false when the host name has no 8.3 form.
+static bool toFcbName(const std::string& host, uint8_t* name){
+    size_t dot = host.rfind('.');
+    std::string base = host.substr(0, dot);
+    std::string ext = (dot == std::string::npos) ? "" : host.substr(dot + 1);
+    if (base.empty() || base.size() > 8 || ext.size() > 3 || base.find('.') != std::string::npos){
+        return false;
+    }
+    memset(name, ' ', 11);
+    for (size_t i = 0; i < base.size(); i++){
+        if (! isgraph((unsigned char)base[i])){
+            return false;
+        }
+        name[i] = toupper((unsigned char)base[i]);
+    }
+    for (size_t i = 0; i < ext.size(); i++){
+        if (! isgraph((unsigned char)ext[i])){
+            return false;
+        }
+        name[8 + i] = toupper((unsigned char)ext[i]);
+    }
+    return true;
+}
+
+// Name in an FCB with the attribute bits stripped
+static std::string fcbName(const uint8_t* fcb){
+    std::string name(11, ' ');
+    for (int i = 0; i < 11; i++){
+        name[i] = toupper(fcb[FCB_NAME + i] & 0x7f);
+    }
+    return name;
+}
+
+// "FOO     COM" -> "foo.com". Empty for wildcards and for names toFcbName would not give,
+// such as ones with a path separator or a dot that could leave the directory.
+static std::string hostName(const std::string& name){
+    std::string base = name.substr(0, 8);
+    std::string ext = name.substr(8, 3);
+    base.erase(base.find_last_not_of(' ') + 1);
+    ext.erase(ext.find_last_not_of(' ') + 1);
+    if (base.empty()){
+        return "";
+    }
+    for (char c : base + ext){
+        if (! isgraph((unsigned char)c) || c == '/' || c == '.' || c == '?'){
+            return "";
+        }
+    }
+    std::string host = ext.empty() ? base : base + "." + ext;
+    std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c){ return tolower(c); });
+    return host;
+}
+
+static uint32_t sequentialRecord(const uint8_t* fcb){
+    return ((fcb[FCB_S2] & 0x3f) * 32 + (fcb[FCB_EX] & 0x1f)) * 128 + (fcb[FCB_CR] & 0x7f);
+}
+
+static void setSequentialRecord(uint8_t* fcb, uint32_t record){
+    fcb[FCB_CR] = record & 0x7f;
+    fcb[FCB_EX] = (record >> 7) & 0x1f;
+    fcb[FCB_S2] = (record >> 12) & 0x3f;
+}
+
+static uint32_t randomRecord(const uint8_t* fcb){
+    return fcb[FCB_R0] | fcb[FCB_R0 + 1] << 8 | fcb[FCB_R0 + 2] << 16;
+}
+
+static void storeRandomRecord(uint8_t* fcb, uint32_t record){
+    fcb[FCB_R0] = record & 0xff;
+    fcb[FCB_R0 + 1] = (record >> 8) & 0xff;
+    fcb[FCB_R0 + 2] = (record >> 16) & 0xff;
+}
+
+// A record was written in the extent the FCB points at
+static void recordWritten(uint8_t* fcb, uint32_t record){
+    if (sequentialRecord(fcb) / 128 == record / 128){
+        fcb[FCB_RC] = std::max<uint8_t>(fcb[FCB_RC], record % 128 + 1);
+    }
+}
+
+static uint32_t fileRecords(FILE* fp){
+    struct stat st{};
+    fflush(fp);
+    if (fstat(fileno(fp), &st) < 0){
+        return 0;
+    }
+    return (st.st_size + Bdos::RECORD_SIZE - 1) / Bdos::RECORD_SIZE;
+}
+
+Bdos::Bdos(const char* _directory) : directory(_directory) {
+    if (this->directory.empty()){
+        this->directory = ".";
+    }
+}
+
+Bdos::~Bdos(){
+    for (auto& entry : this->files){
+        fclose(entry.second.fp);
+    }
+}
+
+bool Bdos::call(Cpu* cpu){
+    uint16_t de = cpu->registers.de();
+    switch (cpu->registers.c){
+        case 12:
+            // Return version number: CP/M 2.2
+            cpu->opCode.bdosResult(0x0022);
+            return true;
+        case 13:
+            // Reset disk system
+            this->dma = DEFAULT_DMA;
+            this->drive = 0;
+            cpu->opCode.bdosResult(0);
+            return true;
+        case 14:
+            // Select disk
+            this->drive = cpu->registers.e & 0x0f;
+            cpu->opCode.bdosResult(0);
+            return true;
+        case 15: cpu->opCode.bdosResult(this->open(cpu, de));              return true;
+        case 16: cpu->opCode.bdosResult(this->close(cpu, de));             return true;
+        case 17: cpu->opCode.bdosResult(this->searchFirst(cpu, de));       return true;
+        case 18: cpu->opCode.bdosResult(this->searchNext(cpu));            return true;
+        case 19: cpu->opCode.bdosResult(this->remove(cpu, de));            return true;
+        case 20: cpu->opCode.bdosResult(this->readSequential(cpu, de));    return true;
+        case 21: cpu->opCode.bdosResult(this->writeSequential(cpu, de));   return true;
+        case 22: cpu->opCode.bdosResult(this->make(cpu, de));              return true;
+        case 23: cpu->opCode.bdosResult(this->rename(cpu, de));            return true;
+        case 24:
+            // Return login vector
+            cpu->opCode.bdosResult(1 << this->drive);
+            return true;
+        case 25:
+            // Return current disk
+            cpu->opCode.bdosResult(this->drive);
+            return true;
+        case 26:
+            // Set DMA address
+            this->dma = de;
+            return true;
+        case 29:
+            // Get read-only vector
+            cpu->opCode.bdosResult(0);
+            return true;
+        case 30:
+            // Set file attributes. The host has no equivalent.
+            cpu->opCode.bdosResult(0);
+            return true;
+        case 32:
+            // Get/set user code
+            if (cpu->registers.e == 0xff){
+                cpu->opCode.bdosResult(this->user);
+            } else {
+                this->user = cpu->registers.e & 0x0f;
+            }
+            return true;
+        case 33: cpu->opCode.bdosResult(this->readRandom(cpu, de));        return true;
+        case 34:
+        case 40: cpu->opCode.bdosResult(this->writeRandom(cpu, de));       return true;
+        case 35: cpu->opCode.bdosResult(this->fileSize(cpu, de));          return true;
+        case 36: cpu->opCode.bdosResult(this->setRandomRecord(cpu, de));   return true;
+        case 37:
+            // Reset drive
+            cpu->opCode.bdosResult(0);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Bdos::saveState(std::vector<uint8_t>& out) const{
+    auto put = [&out](const void* data, size_t size){
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), p, p + size);
+    };
+    // dma, drive, user, open FCB names, then the search position and host names
+    put(&this->dma, sizeof(this->dma));
+    put(&this->drive, 1);
+    put(&this->user, 1);
+    uint32_t count = this->files.size();
+    put(&count, sizeof(count));
+    for (const auto& entry : this->files){
+        put(entry.first.data(), 11);
+    }
+    uint32_t next = this->search_next;
+    put(&next, sizeof(next));
+    count = this->search_results.size();
+    put(&count, sizeof(count));
+    for (const std::string& host : this->search_results){
+        uint8_t length = host.size();
+        put(&length, 1);
+        put(host.data(), length);
+    }
+}
+
+Bdos::SavedState Bdos::parseState(const uint8_t* in, size_t size){
+    const uint8_t* end = in + size;
+    auto get = [&in, end](void* data, size_t length){
+        if (in + length > end){
+            throw std::runtime_error("Truncated snapshot (bdos)");
+        }
+        memcpy(data, in, length);
+        in += length;
+    };
+    SavedState state;
+    get(&state.dma, sizeof(state.dma));
+    get(&state.drive, 1);
+    get(&state.user, 1);
+    uint32_t count;
+    get(&count, sizeof(count));
+    for (uint32_t i = 0; i < count; i++){
+        std::string name(11, ' ');
+        get(&name[0], 11);
+        state.open_files.push_back(name);
+    }
+    get(&state.search_next, sizeof(state.search_next));
+    get(&count, sizeof(count));
+    for (uint32_t i = 0; i < count; i++){
+        uint8_t length;
+        get(&length, 1);
+        std::string host(length, ' ');
+        get(&host[0], length);
+        state.search_results.push_back(host);
+    }
+    return state;
+}
+
+void Bdos::checkState(const uint8_t* in, size_t size){
+    parseState(in, size);
+}
+
+void Bdos::loadState(const uint8_t* in, size_t size){
+    SavedState state = parseState(in, size);
+    this->dma = state.dma;
+    this->drive = state.drive;
+    this->user = state.user;
+    std::map<std::string, OpenFile> open_files;
+    for (const std::string& saved : state.open_files){
+        uint8_t fcb[FCB_SIZE] = {};
+        memcpy(fcb + FCB_NAME, saved.data(), 11);
+        std::string name = fcbName(fcb);
+        auto it = this->files.find(name);
+        if (it != this->files.end()){
+            // Still open: the next access seeks
+            open_files[name] = {it->second.fp, -1, false};
+            this->files.erase(it);
+        } else if (OpenFile* file = this->file(fcb)){
+            open_files[name] = *file;
+            this->files.erase(name);
+        }
+    }
+    for (auto& entry : this->files){
+        fclose(entry.second.fp);
+    }
+    this->files = std::move(open_files);
+    this->search_results = std::move(state.search_results);
+    this->search_next = state.search_next;
+}
+
+uint8_t Bdos::open(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    std::vector<std::string> found = this->find(fcb);
+    if (found.empty()){
+        return 0xff;
+    }
+    // Wildcards open the first match, whose name goes back into the FCB
+    uint8_t name[11];
+    toFcbName(found[0], name);
+    memcpy(fcb + FCB_NAME, name, sizeof(name));
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 0xff;
+    }
+    fcb[FCB_S1] = 0;
+    this->updateRecordCount(file, fcb);
+    writeGuest(cpu, fcb_addr, fcb, FCB_CR);
+    return 0;
+}
+
+uint8_t Bdos::close(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    auto it = this->files.find(fcbName(fcb));
+    if (it != this->files.end()){
+        bool ok = fclose(it->second.fp) == 0;
+        this->files.erase(it);
+        return ok ? 0 : 0xff;
+    }
+    return this->find(fcb).empty() ? 0xff : 0;
+}
+
+uint8_t Bdos::searchFirst(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    if (fcb[FCB_DRIVE] == '?'){
+        // Every entry, of every user
+        memset(fcb + FCB_NAME, '?', 11);
+    }
+    this->search_results = this->find(fcb);
+    this->search_next = 0;
+    return this->searchNext(cpu);
+}
+
+uint8_t Bdos::searchNext(Cpu* cpu){
+    if (this->search_next >= this->search_results.size()){
+        return 0xff;
+    }
+    const std::string& host = this->search_results[this->search_next++];
+
+    uint32_t records = 0;
+    FILE* fp = fopen(this->hostPath(host).c_str(), "rb");
+    if (fp != nullptr){
+        records = fileRecords(fp);
+        fclose(fp);
+    }
+    // One directory entry describing the last extent, then empty entries
+    uint8_t record[RECORD_SIZE];
+    memset(record, 0xe5, sizeof(record));
+    memset(record, 0, 32);
+    record[0] = this->user;
+    toFcbName(host, record + FCB_NAME);
+    uint32_t last = (records > 0) ? (records - 1) / 128 : 0;
+    record[FCB_EX] = last & 0x1f;
+    record[FCB_S2] = (last >> 5) & 0x3f;
+    record[FCB_RC] = records - last * 128;
+    // Allocation map: one nonzero byte per 1KB block of the extent
+    uint32_t blocks = std::min<uint32_t>(16, (record[FCB_RC] + 7) / 8);
+    for (uint32_t i = 0; i < blocks; i++){
+        record[16 + i] = i + 1;
+    }
+    writeGuest(cpu, this->dma, record, sizeof(record));
+    return 0;
+}
+
+uint8_t Bdos::remove(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    std::vector<std::string> found = this->find(fcb);
+    for (const std::string& host : found){
+        uint8_t name[FCB_SIZE] = {};
+        toFcbName(host, name + FCB_NAME);
+        auto it = this->files.find(fcbName(name));
+        if (it != this->files.end()){
+            fclose(it->second.fp);
+            this->files.erase(it);
+        }
+        if (! this->muted){
+            ::remove(this->hostPath(host).c_str());
+        }
+    }
+    return found.empty() ? 0xff : 0;
+}
+
+uint8_t Bdos::readSequential(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 9;
+    }
+    uint32_t record = sequentialRecord(fcb);
+    bool eof = false;
+    if (! this->readRecord(cpu, file, record, eof)){
+        return 0xff;
+    }
+    if (eof){
+        return 1;
+    }
+    this->moveTo(file, fcb, record + 1);
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE - 3);
+    return 0;
+}
+
+uint8_t Bdos::writeSequential(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 9;
+    }
+    uint32_t record = sequentialRecord(fcb);
+    if (! this->writeRecord(cpu, file, record)){
+        return 2;
+    }
+    this->moveTo(file, fcb, record + 1);
+    recordWritten(fcb, record);
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE - 3);
+    return 0;
+}
+
+uint8_t Bdos::make(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    std::string name = fcbName(fcb);
+    if (hostName(name).empty()){
+        return 0xff;
+    }
+    auto it = this->files.find(name);
+    if (it != this->files.end()){
+        fclose(it->second.fp);
+        this->files.erase(it);
+    }
+    // Keep the spelling of a file that is already there
+    std::vector<std::string> found = this->find(fcb);
+    std::string host = found.empty() ? hostName(name) : found[0];
+    // A replay reopens the file the first run made rather than truncating what it wrote since
+    FILE* fp = fopen(this->hostPath(host).c_str(), (this->muted && ! found.empty()) ? "r+b" : "w+b");
+    if (fp == nullptr){
+        return 0xff;
+    }
+    setvbuf(fp, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+    this->files[name] = {fp, 0, false};
+    fcb[FCB_S1] = 0;
+    fcb[FCB_S2] = 0;
+    fcb[FCB_RC] = 0;
+    writeGuest(cpu, fcb_addr, fcb, FCB_CR);
+    return 0;
+}
+
+uint8_t Bdos::rename(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    std::vector<std::string> found = this->find(fcb);
+    if (found.empty()){
+        return 0xff;
+    }
+    // The new name sits in the second half of the FCB
+    std::string host = hostName(fcbName(fcb + 16));
+    if (host.empty()){
+        return 0xff;
+    }
+    auto it = this->files.find(fcbName(fcb));
+    if (it != this->files.end()){
+        fclose(it->second.fp);
+        this->files.erase(it);
+    }
+    if (! this->muted && ::rename(this->hostPath(found[0]).c_str(), this->hostPath(host).c_str()) != 0){
+        return 0xff;
+    }
+    return 0;
+}
+
+uint8_t Bdos::readRandom(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    uint32_t record = randomRecord(fcb);
+    if (record > 0xffff){
+        return 6;
+    }
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 9;
+    }
+    bool eof = false;
+    if (! this->readRecord(cpu, file, record, eof)){
+        return 0xff;
+    }
+    if (eof){
+        return 1;
+    }
+    // The next sequential read returns the same record
+    this->moveTo(file, fcb, record);
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE);
+    return 0;
+}
+
+uint8_t Bdos::writeRandom(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    uint32_t record = randomRecord(fcb);
+    if (record > 0xffff){
+        return 6;
+    }
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 9;
+    }
+    if (! this->writeRecord(cpu, file, record)){
+        return 2;
+    }
+    this->moveTo(file, fcb, record);
+    recordWritten(fcb, record);
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE);
+    return 0;
+}
+
+uint8_t Bdos::fileSize(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    OpenFile* file = this->file(fcb);
+    if (file == nullptr){
+        return 0xff;
+    }
+    storeRandomRecord(fcb, fileRecords(file->fp));
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE);
+    return 0;
+}
+
+uint8_t Bdos::setRandomRecord(Cpu* cpu, uint16_t fcb_addr){
+    uint8_t fcb[FCB_SIZE];
+    readGuest(cpu, fcb_addr, fcb, sizeof(fcb));
+    storeRandomRecord(fcb, sequentialRecord(fcb));
+    writeGuest(cpu, fcb_addr, fcb, FCB_SIZE);
+    return 0;
+}
+
+std::vector<std::string> Bdos::find(const uint8_t* fcb){
+    std::vector<std::string> found;
+    std::string pattern = fcbName(fcb);
+    DIR* dir = opendir(this->directory.c_str());
+    if (dir == nullptr){
+        return found;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr){
+        uint8_t name[11];
+        std::string host = entry->d_name;
+        if (! toFcbName(host, name)){
+            continue;
+        }
+        bool match = true;
+        for (int i = 0; i < 11 && match; i++){
+            match = (pattern[i] == '?' || pattern[i] == name[i]);
+        }
+        struct stat st{};
+        if (match && stat(this->hostPath(host).c_str(), &st) == 0 && S_ISREG(st.st_mode)){
+            found.push_back(host);
+        }
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::string Bdos::hostPath(const std::string& name){
+    return this->directory + "/" + name;
+}
+
+Bdos::OpenFile* Bdos::file(const uint8_t* fcb){
+    std::string name = fcbName(fcb);
+    auto it = this->files.find(name);
+    if (it != this->files.end()){
+        return &it->second;
+    }
+    // Not opened by this name yet (e.g. the program copied an FCB that was open)
+    if (name.find('?') != std::string::npos){
+        return nullptr;
+    }
+    std::vector<std::string> found = this->find(fcb);
+    if (found.empty()){
+        return nullptr;
+    }
+    std::string path = this->hostPath(found[0]);
+    FILE* fp = fopen(path.c_str(), "r+b");
+    if (fp == nullptr){
+        fp = fopen(path.c_str(), "rb");
+    }
+    if (fp == nullptr){
+        return nullptr;
+    }
+    setvbuf(fp, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+    return &(this->files[name] = {fp, 0, false});
+}
+
+bool Bdos::readRecord(Cpu* cpu, OpenFile* file, uint32_t record, bool& eof){
+    long position = (long)record * RECORD_SIZE;
+    if (file->position != position || file->writing){
+        if (fseek(file->fp, position, SEEK_SET) != 0){
+            return false;
+        }
+        file->writing = false;
+    }
+    // Straight into host memory when the record lies in one page
+    uint8_t buffer[RECORD_SIZE];
+    bool direct = cpu->enable_virtual_memory && this->contiguous();
+    uint8_t* target = direct ? &cpu->memory(this->dma) : buffer;
+    size_t size = fread(target, 1, RECORD_SIZE, file->fp);
+    file->position = position + size;
+    if (size == 0){
+        eof = true;
+        return ! ferror(file->fp);
+    }
+    // Partial last record: pad with ^Z
+    memset(target + size, 0x1a, RECORD_SIZE - size);
+    if (direct){
+        cpu->idle_loop.written();
+        for (uint32_t page = this->dma >> 8; page <= (uint32_t)(this->dma + RECORD_SIZE - 1) >> 8; page++){
+            cpu->dirty_pages[page >> 6] |= (uint64_t)1 << (page & 0x3f);
+        }
+    } else {
+        writeGuest(cpu, this->dma, buffer, RECORD_SIZE);
+    }
+    return true;
+}
+
+bool Bdos::contiguous() const{
+    return (this->dma >> Cpu::PAGE_SHIFT) == ((this->dma + RECORD_SIZE - 1) >> Cpu::PAGE_SHIFT);
+}
+
+bool Bdos::writeRecord(Cpu* cpu, OpenFile* file, uint32_t record){
+    if (this->muted){
+        // fp stays where it was
+        file->position = -1;
+        return true;
+    }
+    long position = (long)record * RECORD_SIZE;
+    if (file->position != position || ! file->writing){
+        if (fseek(file->fp, position, SEEK_SET) != 0){
+            return false;
+        }
+        file->writing = true;
+    }
+    uint8_t buffer[RECORD_SIZE];
+    const uint8_t* source = buffer;
+    if (cpu->enable_virtual_memory && this->contiguous()){
+        source = &cpu->memory(this->dma);
+    } else {
+        readGuest(cpu, this->dma, buffer, RECORD_SIZE);
+    }
+    size_t size = fwrite(source, 1, RECORD_SIZE, file->fp);
+    file->position = position + size;
+    return size == RECORD_SIZE;
+}
+
+void Bdos::moveTo(OpenFile* file, uint8_t* fcb, uint32_t record){
+    bool extent_changed = sequentialRecord(fcb) / 128 != record / 128;
+    setSequentialRecord(fcb, record);
+    if (extent_changed){
+        this->updateRecordCount(file, fcb);
+    }
+}
+
+void Bdos::updateRecordCount(OpenFile* file, uint8_t* fcb){
+    uint32_t records = fileRecords(file->fp);
+    uint32_t extent = sequentialRecord(fcb) / 128;
+    uint32_t first = extent * 128;
+    fcb[FCB_RC] = (records <= first) ? 0 : std::min<uint32_t>(128, records - first);
+}
+
+void Bdos::readGuest(Cpu* cpu, uint16_t addr, uint8_t* out, size_t size){
+    for (size_t i = 0; i < size; i++){
+        uint16_t a = addr + i;
+        out[i] = cpu->enable_virtual_memory ? cpu->memory(a) : Mcycle::m2(cpu, a);
+    }
+}
+
+void Bdos::writeGuest(Cpu* cpu, uint16_t addr, const uint8_t* data, size_t size){
+    cpu->idle_loop.written();
+    for (size_t i = 0; i < size; i++){
+        uint16_t a = addr + i;
+        if (cpu->enable_virtual_memory){
+            cpu->memory(a) = data[i];
+            cpu->dirty_pages[a >> 14] |= (uint64_t)1 << ((a >> 8) & 0x3f);
+        } else {
+            Mcycle::m3(cpu, a, data[i]);
+        }
+    }
+}
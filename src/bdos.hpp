@@ -0,0 +1,97 @@
+#ifndef Z80EMU_BDOS_HPP
+#define Z80EMU_BDOS_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+class Cpu;
+
+// CP/M 2.2 BDOS disk functions on top of a host directory.
+// Every drive maps to the same directory. Host names are matched case-insensitively against
+// the 8.3 name in the FCB; new files are created in lower case. Open files are keyed by name, so
+// a program may copy or move its FCB between calls.
+// refs: https://www.seasip.info/Cpm/bdos.html
+class Bdos {
+public:
+    static const uint16_t DEFAULT_DMA = 0x0080;
+    static const uint16_t RECORD_SIZE = 128;
+    static const uint8_t FCB_SIZE = 36;
+
+    explicit Bdos(const char* directory);
+    ~Bdos();
+    Bdos(const Bdos&) = delete;
+    Bdos& operator=(const Bdos&) = delete;
+
+    // Handles the function in register C. Returns false for functions it does not implement.
+    bool call(Cpu* cpu);
+
+    uint16_t dma = DEFAULT_DMA;
+    // Set while history is replayed. Files are opened and read as usual, but writes, make,
+    // delete and rename leave the host directory as the first run left it.
+    bool muted = false;
+
+    // DMA address, drive, user, the open files and a search in progress, for snapshots.
+    // Open files are reopened by name; their contents are the host's.
+    void saveState(std::vector<uint8_t>& out) const;
+    void loadState(const uint8_t* in, size_t size);
+    // Throws like loadState on a malformed state, without changing anything
+    static void checkState(const uint8_t* in, size_t size);
+
+private:
+    struct SavedState {
+        uint16_t dma;
+        uint8_t drive;
+        uint8_t user;
+        // 11-character FCB names
+        std::vector<std::string> open_files;
+        uint32_t search_next;
+        std::vector<std::string> search_results;
+    };
+    struct OpenFile {
+        FILE* fp;
+        // Position of fp, so sequential access does not seek. -1 when unknown.
+        long position;
+        bool writing;
+    };
+
+    std::string directory;
+    std::map<std::string, OpenFile> files;
+    std::vector<std::string> search_results;
+    size_t search_next = 0;
+    uint8_t drive = 0;
+    uint8_t user = 0;
+
+    uint8_t open(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t close(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t searchFirst(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t searchNext(Cpu* cpu);
+    uint8_t remove(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t readSequential(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t writeSequential(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t make(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t rename(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t readRandom(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t writeRandom(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t fileSize(Cpu* cpu, uint16_t fcb_addr);
+    uint8_t setRandomRecord(Cpu* cpu, uint16_t fcb_addr);
+
+    static SavedState parseState(const uint8_t* in, size_t size);
+    std::vector<std::string> find(const uint8_t* pattern);
+    std::string hostPath(const std::string& name);
+    OpenFile* file(const uint8_t* fcb);
+    bool readRecord(Cpu* cpu, OpenFile* file, uint32_t record, bool& eof);
+    bool writeRecord(Cpu* cpu, OpenFile* file, uint32_t record);
+    // The DMA record is in one host page, so it can be read and written in place
+    bool contiguous() const;
+    // Points the FCB at a record, refreshing rc when the extent changes
+    void moveTo(OpenFile* file, uint8_t* fcb, uint32_t record);
+    void updateRecordCount(OpenFile* file, uint8_t* fcb);
+
+    static void readGuest(Cpu* cpu, uint16_t addr, uint8_t* out, size_t size);
+    static void writeGuest(Cpu* cpu, uint16_t addr, const uint8_t* data, size_t size);
+};
+
+#endif //Z80EMU_BDOS_HPP
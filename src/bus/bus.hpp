@@ -1,7 +1,14 @@
 #ifndef Z80EMU_BUS_HPP
 #define Z80EMU_BUS_HPP
 
+#include <array>
 #include <cinttypes>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// One bit per 256-byte page of the 64KB address space
+typedef std::array<uint64_t, 4> PageBitmap;
 
 class Bus {
 public:
@@ -17,7 +24,18 @@ public:
     virtual void waitClockFalling() = 0;
     static void waitNanoSec(int ns);
 
+    // Device state stored in snapshots. Hardware buses have none.
+    // With delta, only what changed since the previous save is appended.
+    virtual void saveState(std::vector<uint8_t>&, bool) {}
+    virtual void loadState(const uint8_t*, size_t) {}
+    // Throws like loadState on a malformed state, without changing anything
+    virtual void checkState(const uint8_t*, size_t) const {}
+    // State changed since the last saveState or loadState
+    virtual bool modified() const { return false; }
+
     uint16_t address = 0;
+    // Trace output for bus events. Nothing is written when null.
+    std::ostream* log_sink = nullptr;
 
     uint8_t pin_o_m1 = PIN_HIGH;
     uint8_t pin_o_rfsh = PIN_HIGH;
@@ -0,0 +1,76 @@
+#include "bus_worker.hpp"
+#include "../mcycle.hpp"
+
+BusWorker::BusWorker(Bus* _bus) : bus(_bus){
+    this->thread = std::thread([this](){ this->run(); });
+}
+
+BusWorker::~BusWorker(){
+    this->drain();
+    this->stopping.store(true, std::memory_order_release);
+    this->thread.join();
+}
+
+void BusWorker::push(uint8_t kind, uint16_t addr, uint8_t data){
+    uint32_t tail_now = this->tail.load(std::memory_order_relaxed);
+    // Full: the Cpu thread is that far ahead of the bus
+    while (tail_now - this->head.load(std::memory_order_acquire) >= QUEUE_SIZE){
+        std::this_thread::yield();
+    }
+    this->queue[tail_now % QUEUE_SIZE] = {kind, data, addr};
+    this->tail.store(tail_now + 1, std::memory_order_release);
+}
+
+void BusWorker::write(bool io, uint16_t addr, uint8_t data){
+    this->push(io ? IO_WRITE : MEM_WRITE, addr, data);
+}
+
+uint64_t BusWorker::read(bool io, uint16_t addr, uint8_t* data){
+    this->push(io ? IO_READ : MEM_READ, addr, 0);
+    uint64_t result = this->drain();
+    *data = this->read_data.load(std::memory_order_relaxed);
+    return result;
+}
+
+uint64_t BusWorker::drain(){
+    uint32_t tail_now = this->tail.load(std::memory_order_relaxed);
+    // The value is needed now: spin rather than sleep
+    for (uint32_t spins = 0; this->head.load(std::memory_order_acquire) != tail_now; spins++){
+        if (spins > SPIN_LIMIT){
+            std::this_thread::yield();
+        }
+    }
+    return this->waits.exchange(0, std::memory_order_relaxed);
+}
+
+void BusWorker::run(){
+    uint32_t idle = 0;
+    while (true){
+        uint32_t head_now = this->head.load(std::memory_order_relaxed);
+        if (head_now == this->tail.load(std::memory_order_acquire)){
+            if (this->stopping.load(std::memory_order_acquire)){
+                return;
+            }
+            // The Cpu thread runs from host memory for a while
+            if (++idle > SPIN_LIMIT){
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        idle = 0;
+        const Transaction& t = this->queue[head_now % QUEUE_SIZE];
+        uint8_t data = 0;
+        uint64_t cycle_waits = 0;
+        switch (t.kind){
+            case MEM_READ: cycle_waits = Mcycle::memReadCycle(this->bus, t.addr, &data); break;
+            case MEM_WRITE: cycle_waits = Mcycle::memWriteCycle(this->bus, t.addr, t.data); break;
+            case IO_READ: cycle_waits = Mcycle::ioReadCycle(this->bus, t.addr, &data); break;
+            default: cycle_waits = Mcycle::ioWriteCycle(this->bus, t.addr, t.data); break;
+        }
+        this->read_data.store(data, std::memory_order_relaxed);
+        this->waits.fetch_add(cycle_waits, std::memory_order_relaxed);
+        // Sampled at the end of every M-cycle, as the Cpu thread would
+        this->busrq_low.store(! this->bus->getInput(Bus::Z80_PIN_I_BUSRQ), std::memory_order_relaxed);
+        this->head.store(head_now + 1, std::memory_order_release);
+    }
+}
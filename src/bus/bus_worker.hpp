@@ -0,0 +1,73 @@
+#ifndef Z80EMU_BUS_WORKER_HPP
+#define Z80EMU_BUS_WORKER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "bus.hpp"
+
+// Runs the bus side of memory and I/O cycles on a thread of its own, so that on a multi-core
+// board the GPIO sequencing overlaps decoding and executing the next instructions.
+//
+// The Cpu thread is the only producer and the worker the only consumer of a ring of
+// transactions. Writes are posted and return at once. A read waits until the worker has done
+// it and everything queued ahead of it, so the bus sees the cycles in program order. Anything
+// else that drives the bus from the Cpu thread (fetch, HALT and interrupt acknowledge cycles,
+// pin sampling, BUSACK) first calls Cpu::syncBus, which waits for the queue to empty.
+class BusWorker {
+public:
+    static const uint32_t QUEUE_SIZE = 256;
+    // Polls of the queue before a waiting thread yields. On a core of its own yield returns at
+    // once; where both threads share one it hands the core over.
+    static const uint32_t SPIN_LIMIT = 1 << 10;
+
+    explicit BusWorker(Bus* bus);
+    // Finishes the posted writes first
+    ~BusWorker();
+    BusWorker(const BusWorker&) = delete;
+    BusWorker& operator=(const BusWorker&) = delete;
+
+    void write(bool io, uint16_t addr, uint8_t data);
+    // Returns the wait states of this cycle and of the writes finished since the last read or drain
+    uint64_t read(bool io, uint16_t addr, uint8_t* data);
+    // Waits until every posted write is on the bus. Returns the wait states like read.
+    uint64_t drain();
+    // BUSRQ was low at the end of the last cycle done
+    bool busRequested() const{
+        return this->busrq_low.load(std::memory_order_acquire);
+    }
+    // The Cpu thread has waited for BUSRQ to go high again
+    void busReleased(){
+        this->busrq_low.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    static const uint8_t MEM_READ = 0;
+    static const uint8_t MEM_WRITE = 1;
+    static const uint8_t IO_READ = 2;
+    static const uint8_t IO_WRITE = 3;
+
+    struct Transaction {
+        uint8_t kind;
+        uint8_t data;
+        uint16_t addr;
+    };
+
+    Bus* bus;
+    std::array<Transaction, QUEUE_SIZE> queue{};
+    // Written by the Cpu thread only. Kept apart from head so the two cores do not share a line.
+    alignas(64) std::atomic<uint32_t> tail{0};
+    // Written by the worker only
+    alignas(64) std::atomic<uint32_t> head{0};
+    std::atomic<uint64_t> waits{0};
+    std::atomic<uint8_t> read_data{0};
+    std::atomic<bool> busrq_low{false};
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    void push(uint8_t kind, uint16_t addr, uint8_t data);
+    void run();
+};
+
+#endif //Z80EMU_BUS_WORKER_HPP
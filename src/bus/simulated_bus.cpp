@@ -0,0 +1,120 @@
+#include <cstring>
+#include <stdexcept>
+#include "simulated_bus.hpp"
+#include "../snapshot.hpp"
+
+void SimulatedBus::setAddress(uint16_t addr){
+    this->address = addr;
+}
+
+void SimulatedBus::setDataBegin(uint8_t data){
+    this->data_out = data;
+    this->driving = true;
+}
+
+void SimulatedBus::setDataEnd(){
+    this->driving = false;
+}
+
+uint8_t SimulatedBus::getData(){
+    if (this->pin_o_m1 == PIN_LOW && this->pin_o_iorq == PIN_LOW){
+        // Interrupt acknowledge
+        return this->int_vector;
+    }
+    if (this->pin_o_rd == PIN_LOW){
+        if (this->pin_o_mreq == PIN_LOW){
+            return this->memory[this->address];
+        }
+        if (this->pin_o_iorq == PIN_LOW){
+            return this->io[this->address & 0xff];
+        }
+    }
+    // Nobody drives the bus
+    return 0xff;
+}
+
+void SimulatedBus::setControl(uint8_t z80PinName, bool level){
+    switch (z80PinName){
+        case Z80_PIN_O_HALT:    this->pin_o_halt = level;   break;
+        case Z80_PIN_O_MERQ:    this->pin_o_mreq = level;   break;
+        case Z80_PIN_O_IORQ:    this->pin_o_iorq = level;   break;
+        case Z80_PIN_O_RD:      this->pin_o_rd = level;     break;
+        case Z80_PIN_O_WR:      this->pin_o_wr = level;     break;
+        case Z80_PIN_O_BUSACK:  this->pin_o_busack = level; break;
+        case Z80_PIN_O_M1:      this->pin_o_m1 = level;     break;
+        case Z80_PIN_O_RFSH:    this->pin_o_rfsh = level;   break;
+        default:
+            throw std::logic_error("Invalid Z80 pin (setControl)");
+    }
+}
+
+bool SimulatedBus::getInput(uint8_t z80PinName){
+    switch (z80PinName){
+        case Z80_PIN_I_CLK:
+            this->clock = !this->clock;
+            return this->clock;
+        case Z80_PIN_I_INT:
+            return this->pin_i_int;
+        case Z80_PIN_I_NMI:
+            return this->pin_i_nmi;
+        case Z80_PIN_I_WAIT:
+            return this->pin_i_wait;
+        case Z80_PIN_I_BUSRQ:
+            return this->pin_i_busrq;
+        case Z80_PIN_I_RESET:
+            return this->pin_i_reset;
+        default:
+            throw std::logic_error("Invalid Z80 pin (getInput)");
+    }
+}
+
+void SimulatedBus::syncControl(){
+    // Memory and I/O latch the data bus while WR is active
+    if (this->pin_o_wr == PIN_LOW && this->driving){
+        if (this->pin_o_mreq == PIN_LOW){
+            this->memory[this->address] = this->data_out;
+            this->dirty_pages[this->address >> 14] |= (uint64_t)1 << ((this->address >> 8) & 0x3f);
+        } else if (this->pin_o_iorq == PIN_LOW){
+            this->io[this->address & 0xff] = this->data_out;
+        }
+    }
+}
+
+void SimulatedBus::waitClockRising(){
+    // The simulated clock never makes the CPU wait.
+}
+void SimulatedBus::waitClockFalling(){
+    // The simulated clock never makes the CPU wait.
+}
+
+void SimulatedBus::saveState(std::vector<uint8_t>& out, bool delta){
+    out.insert(out.end(), this->io.begin(), this->io.end());
+    out.push_back(this->int_vector);
+    Snapshot::savePages(this->memory.data(), delta ? &this->dirty_pages : nullptr, out);
+    this->dirty_pages.fill(0);
+}
+
+bool SimulatedBus::modified() const{
+    for (uint64_t word : this->dirty_pages){
+        if (word != 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+void SimulatedBus::checkState(const uint8_t* in, size_t size) const{
+    if (size < this->io.size() + 1){
+        throw std::runtime_error("Truncated snapshot (bus)");
+    }
+    Snapshot::checkPages(in + this->io.size() + 1, size - this->io.size() - 1);
+}
+
+void SimulatedBus::loadState(const uint8_t* in, size_t size){
+    this->checkState(in, size);
+    memcpy(this->io.data(), in, this->io.size());
+    in += this->io.size();
+    this->int_vector = *in++;
+    Snapshot::loadPages(this->memory.data(), in, size - this->io.size() - 1);
+    this->dirty_pages.fill(0);
+}
@@ -0,0 +1,41 @@
+#ifndef Z80EMU_SIMULATEDBUS_HPP
+#define Z80EMU_SIMULATEDBUS_HPP
+
+#include <array>
+#include "bus.hpp"
+
+// Bus without hardware. Memory and I/O devices are host arrays that react to the control pins
+// the same way the adapter board does, so the Mcycle functions run unchanged.
+class SimulatedBus : public Bus {
+public:
+    void setAddress(uint16_t addr) override;
+    void setDataBegin(uint8_t data) override;
+    void setDataEnd() override;
+    uint8_t getData() override;
+    void setControl(uint8_t z80PinName, bool level) override;
+    bool getInput(uint8_t z80PinName) override;
+    void syncControl() override;
+
+    void waitClockRising() override;
+    void waitClockFalling() override;
+
+    void saveState(std::vector<uint8_t>& out, bool delta) override;
+    void loadState(const uint8_t* in, size_t size) override;
+    void checkState(const uint8_t* in, size_t size) const override;
+    bool modified() const override;
+
+    std::array<uint8_t, 0x10000> memory{};
+    std::array<uint8_t, 0x100> io{};
+    // Placed on the data bus during an interrupt acknowledge cycle
+    uint8_t int_vector = 0xff;
+
+private:
+    // Pages of memory written since the last saveState
+    PageBitmap dirty_pages{};
+    uint8_t data_out = 0;
+    bool driving = false;
+    bool clock = false;
+};
+
+
+#endif //Z80EMU_SIMULATEDBUS_HPP
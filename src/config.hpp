@@ -1,6 +1,8 @@
 #ifndef Z80EMU_CONFIG_HPP
 #define Z80EMU_CONFIG_HPP
 
+#ifndef Z80EMU_DISABLE_LOG
 #define Z80EMU_ENABLE_LOG
+#endif
 
 #endif //Z80EMU_CONFIG_HPP
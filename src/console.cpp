@@ -0,0 +1,275 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "console.hpp"
+#include "cpu.hpp"
+
+// Settings of the terminal on stdin, put back however the process ends
+static struct termios saved_termios;
+static volatile sig_atomic_t termios_changed = 0;
+
+static void restoreTermios(){
+    if (termios_changed){
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+        termios_changed = 0;
+    }
+}
+
+static void restoreTermiosAndDie(int sig){
+    restoreTermios();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+Console::Console() : Console(STDIN_FILENO, STDOUT_FILENO) {
+    // stdin stays blocking: poll() looks before each read. O_NONBLOCK would be shared with
+    // stdout when both are the same terminal.
+    if (isatty(this->fd_in) && tcgetattr(this->fd_in, &saved_termios) == 0){
+        static bool handlers_installed = false;
+        if (! handlers_installed){
+            atexit(restoreTermios);
+            for (int sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT}){
+                signal(sig, restoreTermiosAndDie);
+            }
+            handlers_installed = true;
+        }
+        // Characters as typed, without echo. CP/M programs echo for themselves and expect CR.
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_iflag &= ~(ICRNL | IXON);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        termios_changed = 1;
+        tcsetattr(this->fd_in, TCSANOW, &raw);
+        this->restore_termios = true;
+    }
+}
+
+Console::Console(int _fd_in, int _fd_out) : fd_in(_fd_in), fd_out(_fd_out) {}
+
+Console* Console::openPty(){
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0){
+        throw std::runtime_error("Cannot open pty");
+    }
+    const char* name = ptsname(master);
+    // Held open so the master does not see EOF while no terminal is attached
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0){
+        close(master);
+        throw std::runtime_error("Cannot open pty slave");
+    }
+    struct termios raw{};
+    tcgetattr(slave, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(slave, TCSANOW, &raw);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    auto console = new Console(master, master);
+    console->pty_slave = slave;
+    console->pty_name = name;
+    return console;
+}
+
+Console* Console::detached(){
+    return new Console(-1, -1);
+}
+
+Console::~Console(){
+    this->flush();
+    if (this->restore_termios){
+        restoreTermios();
+    }
+    if (this->pty_slave >= 0){
+        close(this->pty_slave);
+        close(this->fd_in);
+    }
+}
+
+void Console::write(uint8_t chr, uint64_t now){
+    if (this->output.full() && ! this->writePending(true)){
+        this->dropped++;
+        return;
+    }
+    this->output.push(chr);
+    if (chr == '\n' || this->output.full()
+            || (this->scheduler == nullptr && now - this->last_flush >= FLUSH_INTERVAL)){
+        this->last_flush = now;
+        this->writePending(false);
+    } else if (this->scheduler != nullptr && ! this->flush_posted){
+        this->flush_posted = true;
+        this->scheduler->post(now + FLUSH_INTERVAL, [this](uint64_t){
+            this->flush_posted = false;
+            this->writePending(false);
+        });
+    }
+}
+
+int Console::read(uint64_t now){
+    if (this->input.empty()){
+        this->poll(now);
+    }
+    return this->input.empty() ? -1 : this->input.pop();
+}
+
+bool Console::ready(uint64_t now){
+    if (this->input.empty()){
+        this->poll(now);
+    }
+    return ! this->input.empty();
+}
+
+bool Console::closed(){
+    return this->input_closed && this->input.empty();
+}
+
+bool Console::lineReady(uint64_t now){
+    for (int pass = 0; pass < 2; pass++){
+        for (size_t i = 0; i < this->input.size(); i++){
+            uint8_t chr = this->input.peek(i);
+            if (chr == '\r'){
+                return true;
+            }
+        }
+        if (this->input_closed || this->input.full()){
+            return true;
+        }
+        if (pass == 0){
+            this->poll(now);
+        }
+    }
+    return false;
+}
+
+void Console::wait(int ms){
+    this->flush();
+    if (this->fd_in < 0 || this->input_closed){
+        return;
+    }
+    struct pollfd pfd{this->fd_in, POLLIN, 0};
+    ::poll(&pfd, 1, ms);
+    // Let the next read go to the host straight away
+    this->last_poll = 0;
+}
+
+void Console::flush(){
+    this->writePending(true);
+}
+
+void Console::feed(const std::string& data){
+    for (char chr : data){
+        this->receive((uint8_t)chr);
+    }
+}
+
+void Console::closeInput(){
+    this->input_closed = true;
+}
+
+uint8_t Console::status(uint64_t now){
+    return (this->ready(now) ? STATUS_RX_READY : 0) | STATUS_TX_READY;
+}
+
+uint8_t Console::ioRead(Cpu* cpu, uint16_t port){
+    if ((port & 0xff) == this->status_port){
+        return this->status(cpu->tick);
+    }
+    int data = this->read(cpu->tick);
+    return (data < 0) ? 0 : data;
+}
+
+void Console::ioWrite(Cpu* cpu, uint16_t port, uint8_t data){
+    if ((port & 0xff) == this->data_port){
+        this->write(data, cpu->tick);
+    }
+}
+
+size_t Console::writeBlock(Cpu* cpu, uint16_t port, const uint8_t* data, size_t count){
+    if ((port & 0xff) != this->data_port){
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++){
+        this->write(data[i], cpu->tick);
+    }
+    return count;
+}
+
+void Console::poll(uint64_t now){
+    // Anything the program printed belongs before its next prompt
+    this->writePending(false);
+    if (this->fd_in < 0 || this->input_closed){
+        return;
+    }
+    if (this->last_poll != 0 && now - this->last_poll < POLL_INTERVAL){
+        return;
+    }
+    this->last_poll = now == 0 ? 1 : now;
+
+    uint8_t buffer[BUFFER_SIZE];
+    size_t room = BUFFER_SIZE - this->input.size();
+    if (room == 0){
+        return;
+    }
+    // Readable also covers end of input
+    struct pollfd pfd{this->fd_in, POLLIN, 0};
+    if (::poll(&pfd, 1, 0) <= 0){
+        return;
+    }
+    ssize_t size = ::read(this->fd_in, buffer, room);
+    if (size > 0){
+        for (ssize_t i = 0; i < size; i++){
+            this->receive(buffer[i]);
+        }
+    } else if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+        // A pty master reads EIO while no terminal is attached. That is not the end of input.
+        if (this->pty_slave < 0){
+            this->input_closed = true;
+        }
+    }
+}
+
+void Console::receive(uint8_t chr){
+    // CP/M ends lines with CR. LF from pipes and files becomes CR, and CR LF a single CR.
+    bool after_cr = this->last_received == '\r';
+    this->last_received = chr;
+    if (chr == '\n' && this->translate_newlines){
+        if (after_cr){
+            return;
+        }
+        chr = '\r';
+    }
+    this->input.push(chr);
+}
+
+bool Console::writePending(bool block){
+    if (this->fd_out < 0){
+        this->output.drop(this->output.size());
+        return true;
+    }
+    while (! this->output.empty()){
+        const uint8_t* data;
+        size_t size = this->output.contiguous(&data);
+        ssize_t written = ::write(this->fd_out, data, size);
+        if (written > 0){
+            this->output.drop(written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR){
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && block){
+            struct pollfd pfd{this->fd_out, POLLOUT, 0};
+            if (::poll(&pfd, 1, 100) > 0){
+                continue;
+            }
+        }
+        return false;
+    }
+    return true;
+}
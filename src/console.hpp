@@ -0,0 +1,139 @@
+#ifndef Z80EMU_CONSOLE_HPP
+#define Z80EMU_CONSOLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "io.hpp"
+
+class Scheduler;
+
+// Fixed-size byte FIFO. Not thread-safe; the console is only used from the CPU thread.
+template <size_t N>
+class RingBuffer {
+public:
+    static_assert((N & (N - 1)) == 0, "RingBuffer size must be a power of two");
+
+    bool empty() const { return this->head == this->tail; }
+    bool full() const { return this->size() == N; }
+    size_t size() const { return this->head - this->tail; }
+
+    bool push(uint8_t data){
+        if (this->full()){
+            return false;
+        }
+        this->buffer[this->head++ & (N - 1)] = data;
+        return true;
+    }
+    uint8_t pop(){
+        return this->buffer[this->tail++ & (N - 1)];
+    }
+    uint8_t peek(size_t i) const {
+        return this->buffer[(this->tail + i) & (N - 1)];
+    }
+    // Longest run that can be read without wrapping
+    size_t contiguous(const uint8_t** data) const {
+        size_t start = this->tail & (N - 1);
+        *data = this->buffer.data() + start;
+        return std::min(this->size(), N - start);
+    }
+    void drop(size_t count){
+        this->tail += count;
+    }
+
+private:
+    std::array<uint8_t, N> buffer{};
+    size_t head = 0;
+    size_t tail = 0;
+};
+
+// Console device for BDOS console functions and an optional pair of I/O ports.
+//
+// Output collects in a ring buffer and goes to the host in batched writes: on a newline, when
+// the buffer fills, when the program asks for input, or FLUSH_INTERVAL T-states after it was
+// written. Input is polled without blocking, at most once per POLL_INTERVAL T-states while the
+// buffer is empty, so a program spinning on console status does not make a syscall per iteration.
+class Console : public IoDevice {
+public:
+    static const size_t BUFFER_SIZE = 4096;
+    static const uint64_t POLL_INTERVAL = 10000;
+    static const uint64_t FLUSH_INTERVAL = 1000 * 1000;
+
+    // Port status bits
+    static const uint8_t STATUS_RX_READY = 0x01;
+    static const uint8_t STATUS_TX_READY = 0x02;
+
+    // stdin/stdout. A terminal is switched to raw input until the console is destroyed or the
+    // process exits or is killed by SIGINT, SIGTERM, SIGHUP or SIGQUIT.
+    Console();
+    // A new pseudo terminal. Connect to name() with a terminal program.
+    static Console* openPty();
+    // No host side: input comes from feed(), output is discarded
+    static Console* detached();
+    ~Console();
+    Console(const Console&) = delete;
+    Console& operator=(const Console&) = delete;
+
+    void write(uint8_t chr, uint64_t now);
+    // Next input character, or -1 when there is none yet
+    int read(uint64_t now);
+    bool ready(uint64_t now);
+    // The next ready or read looks at the host whatever the T-state, e.g. after the host slept
+    void pollSoon(){ this->last_poll = 0; }
+    // Input has ended and everything has been read
+    bool closed();
+    // A whole line is buffered (or input has ended)
+    bool lineReady(uint64_t now);
+    // Blocks up to ms for input. For programs that cannot continue without it.
+    void wait(int ms);
+    void flush();
+
+    void feed(const std::string& input);
+    void closeInput();
+
+    const std::string& name(){ return this->pty_name; }
+
+    // Port pair when attached to an IoMap: data in/out and status
+    uint8_t data_port = 0x00;
+    uint8_t status_port = 0x01;
+    uint8_t status(uint64_t now);
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+    // OTIR of a whole string to the data port
+    size_t writeBlock(Cpu* cpu, uint16_t port, const uint8_t* data, size_t count) override;
+
+    // LF to CR for CP/M programs. Off for a serial line, which passes bytes unchanged.
+    bool translate_newlines = true;
+    // Flushes a partial line, e.g. a prompt, from an event FLUSH_INTERVAL T-states after it was
+    // written. Without one it waits for the next character or input poll.
+    Scheduler* scheduler = nullptr;
+
+    // Output lost because the host side did not keep up
+    uint64_t dropped = 0;
+
+private:
+    Console(int fd_in, int fd_out);
+
+    int fd_in;
+    int fd_out;
+    int pty_slave = -1;
+    std::string pty_name;
+    bool input_closed = false;
+    bool restore_termios = false;
+    uint64_t last_poll = 0;
+    uint64_t last_flush = 0;
+    bool flush_posted = false;
+
+    RingBuffer<BUFFER_SIZE> input;
+    RingBuffer<BUFFER_SIZE> output;
+
+    uint8_t last_received = 0;
+
+    void poll(uint64_t now);
+    void receive(uint8_t chr);
+    bool writePending(bool block);
+};
+
+#endif //Z80EMU_CONSOLE_HPP
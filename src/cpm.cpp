@@ -0,0 +1,108 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "cpm.hpp"
+#include "cpu.hpp"
+
+std::vector<uint8_t> Cpm::readImage(const char* path){
+    FILE* fp = fopen(path, "rb");
+    if (fp == nullptr){
+        throw std::runtime_error("Cannot open CP/M image");
+    }
+    std::vector<uint8_t> image;
+    uint8_t buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0){
+        image.insert(image.end(), buffer, buffer + size);
+    }
+    fclose(fp);
+    return image;
+}
+
+void Cpm::load(Cpu* cpu, const std::vector<uint8_t>& image, const char* tail){
+    if (image.size() > BDOS_ENTRY - TPA){
+        throw std::runtime_error("CP/M image does not fit in the TPA");
+    }
+    for (uint32_t addr = 0; addr < 0x10000; addr++){
+        cpu->memory(addr) = 0x00;
+    }
+    // 0000: jp BOOT. Reaching it is a warm boot.
+    cpu->memory(0x0000) = 0xc3;
+    cpu->memory(0x0001) = 0x03;
+    cpu->memory(0x0002) = 0x00;
+    // 0005: jp BDOS. (0006) is also the top of the TPA.
+    cpu->memory(0x0005) = 0xc3;
+    cpu->memory(0x0006) = BDOS_ENTRY & 0xff;
+    cpu->memory(0x0007) = BDOS_ENTRY >> 8;
+    // Cpu::step runs the BDOS function when PC gets here, by call 5, jp 5 or jp (hl) alike. Then this ret.
+    cpu->memory(BDOS_ENTRY) = 0xc9;
+    for (size_t i = 0; i < image.size(); i++){
+        cpu->memory(TPA + i) = image[i];
+    }
+
+    // Command tail: length, then the upper-cased arguments with a leading space
+    uint8_t length = 0;
+    if (*tail != '\0'){
+        cpu->memory(COMMAND_TAIL + 1) = ' ';
+        length = 1;
+        for (; *tail != '\0' && length < 0x7f; tail++, length++){
+            cpu->memory(COMMAND_TAIL + 1 + length) = toupper((unsigned char)*tail);
+        }
+    }
+    cpu->memory(COMMAND_TAIL) = length;
+
+    // The first two arguments as FCBs
+    // The zero page is within one host page
+    std::string args((const char*)&cpu->memory(COMMAND_TAIL + 1), length);
+    std::vector<std::string> tokens;
+    size_t pos = 0;
+    while ((pos = args.find_first_not_of(' ', pos)) != std::string::npos && tokens.size() < 2){
+        size_t end = args.find(' ', pos);
+        tokens.push_back(args.substr(pos, end - pos));
+        pos = end;
+    }
+    for (int i = 0; i < 2; i++){
+        parseFileName(i < (int)tokens.size() ? tokens[i] : "", &cpu->memory(i == 0 ? DEFAULT_FCB1 : DEFAULT_FCB2));
+    }
+
+    cpu->dirty_pages.fill(~(uint64_t)0);
+    cpu->enable_virtual_memory = true;
+    cpu->emulate_cpm_bdos_call = true;
+    cpu->stopped = false;
+    cpu->halt = false;
+    cpu->special_registers.pc = TPA;
+    // ret from the program returns to 0000
+    cpu->special_registers.sp = BDOS_ENTRY - 2;
+}
+
+void Cpm::parseFileName(const std::string& token, uint8_t* fcb){
+    memset(fcb, 0, 16);
+    memset(fcb + 1, ' ', 11);
+    size_t pos = 0;
+    if (token.size() >= 2 && token[1] == ':' && isalpha((unsigned char)token[0])){
+        fcb[0] = toupper((unsigned char)token[0]) - 'A' + 1;
+        pos = 2;
+    }
+    // Name, then type after the dot
+    int field = 1;
+    int limit = 8;
+    for (int n = 0; pos < token.size(); pos++){
+        char c = token[pos];
+        if (c == '.' && field == 1){
+            field = 9;
+            limit = 3;
+            n = 0;
+            continue;
+        }
+        if (n >= limit){
+            continue;
+        }
+        if (c == '*'){
+            memset(fcb + field + n, '?', limit - n);
+            n = limit;
+            continue;
+        }
+        fcb[field + n++] = toupper((unsigned char)c);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef Z80EMU_CPM_HPP
+#define Z80EMU_CPM_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Cpu;
+
+// Minimal CP/M environment for running .COM files from host memory.
+// refs: https://www.seasip.info/Cpm/format22.html
+class Cpm {
+public:
+    static const uint16_t DEFAULT_FCB1 = 0x005c;
+    static const uint16_t DEFAULT_FCB2 = 0x006c;
+    static const uint16_t COMMAND_TAIL = 0x0080;
+    static const uint16_t TPA = 0x0100;
+    static const uint16_t BDOS_ENTRY = 0xfe00;
+
+    static std::vector<uint8_t> readImage(const char* path);
+    // Sets up page zero like the CCP does: command tail and the two default FCBs
+    static void load(Cpu* cpu, const std::vector<uint8_t>& image, const char* tail = "");
+    // "B:NAME.EXT" into the drive, name and type of an FCB. * expands to ?.
+    static void parseFileName(const std::string& token, uint8_t* fcb);
+};
+
+#endif //Z80EMU_CPM_HPP
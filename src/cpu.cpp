@@ -1,24 +1,62 @@
+#include <cerrno>
 #include <cstdio>
 #include <ctime>
 #include "stdexcept"
 #include "cpu.hpp"
+#include "console.hpp"
+#include "cpm.hpp"
 #include "mcycle.hpp"
 #include "opcode.hpp"
 #include "log.hpp"
+#include "snapshot.hpp"
+#include "bus/bus_worker.hpp"
 
-Cpu::Cpu(Bus *_bus)
+Cpu::Cpu(Bus *_bus) : bus(_bus), opCode(this), idle_loop(this), debug(this)
 {
-    this->bus = _bus;
+    this->resetPageTable();
+}
+
+void Cpu::resetPageTable(){
+    for (int i = 0; i < PAGE_COUNT; i++){
+        this->page_table[i] = this->virtual_memory.data() + (i << PAGE_SHIFT);
+    }
+}
 
-    OpCode _opCode(this);
-    this->opCode = _opCode;
+void Cpu::mapToBus(uint16_t from, uint16_t to){
+    if (to < from){
+        throw std::runtime_error("Bus window ends before it starts");
+    }
+    for (uint32_t page = from >> 8; page <= (uint32_t)to >> 8; page++){
+        this->bus_pages[page >> 6] |= (uint64_t)1 << (page & 0x3f);
+    }
+    this->has_bus_pages = true;
+}
 
-    Registers resistors;
-    this->registers = resistors;
-    Registers resistorsAlternate;
-    this->registers_alternate = resistorsAlternate;
-    SpecialRegisters specialResistors;
-    this->special_registers = specialResistors;
+bool Cpu::onBus(uint16_t addr, size_t count) const{
+    if (! this->has_bus_pages || count == 0){
+        return false;
+    }
+    for (uint32_t page = addr >> 8; page <= (uint32_t)(addr + count - 1) >> 8; page++){
+        if (this->bus_pages[(page >> 6) & 3] >> (page & 0x3f) & 1){
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cpu::copyFromBus(uint16_t from, uint32_t size){
+    bool host = this->enable_virtual_memory;
+    uint64_t saved_tick = this->tick;
+    Metrics saved_metrics = this->metrics;
+    this->enable_virtual_memory = false;
+    for (uint32_t i = 0; i < size; i++){
+        auto addr = (uint16_t)(from + i);
+        this->memory(addr) = Mcycle::m2(this, addr);
+        this->dirty_pages[addr >> 14] |= (uint64_t)1 << ((addr >> 8) & 0x3f);
+    }
+    this->enable_virtual_memory = host;
+    this->tick = saved_tick;
+    this->metrics = saved_metrics;
 }
 
 void Cpu::reset()
@@ -34,6 +72,7 @@ void Cpu::reset()
     this->interrupt_mode = 0;
     // TODO: the address and data bus go to a high-impedance state
     // all control output signals go to the inactive state
+    this->syncBus();
     this->bus->pin_o_m1 = true;
     this->bus->pin_o_rfsh = true;
     this->bus->pin_o_halt = true;
@@ -46,110 +85,322 @@ void Cpu::reset()
     this->bus->syncControl();
 }
 
-void Cpu::instructionCycle(){
-    #pragma clang diagnostic push
-    #pragma ide diagnostic ignored "EndlessLoop"
-    int instructions = 0;
-    clock_t start = clock();
-    clock_t lastReset = start;
-    while(true){
-        if (!this->bus->getInput(Bus::Z80_PIN_I_RESET)){
-            while(!this->bus->getInput(Bus::Z80_PIN_I_RESET));
-
-            const double time = static_cast<double>(clock() - lastReset) / CLOCKS_PER_SEC * 1000.0;
-            if (time > 1000){
-                printf("Resetting\n");
-                Log::general(this, "Reset");
-                this->reset();
-                lastReset = clock();
-            }
+void Cpu::consoleOutput(uint8_t chr){
+    if (this->console_output){
+        this->console_output(chr);
+    } else if (this->console != nullptr){
+        this->console->write(chr, this->tick);
+    } else {
+        putchar(chr);
+        fflush(stdout);
+    }
+}
+
+void Cpu::setPinPolling(uint64_t interval){
+    this->pin_poll_interval = interval;
+    uint64_t generation = ++this->pin_poll_generation;
+    this->pin_reset_low = false;
+    this->pin_nmi_low = false;
+    this->pin_int_low = false;
+    if (interval <= 1){
+        return;
+    }
+    this->scheduler.post(this->tick + interval, [this, generation](uint64_t now){
+        this->pinPollEvent(generation, now);
+    });
+}
+
+void Cpu::pinPollEvent(uint64_t generation, uint64_t now){
+    // Reposts itself until setPinPolling is called again
+    if (generation != this->pin_poll_generation){
+        return;
+    }
+    this->samplePins();
+    this->scheduler.post(now + this->pin_poll_interval, [this, generation](uint64_t at){
+        this->pinPollEvent(generation, at);
+    });
+}
+
+void Cpu::setRealtime(uint64_t clock_hz){
+    this->realtime_hz = clock_hz;
+    this->realtime_tick = this->tick;
+    this->realtime_ns = monotonic_ns();
+}
+
+void Cpu::setIdleDetection(bool enable){
+    this->idle_detection = enable;
+    this->idle_loop.reset();
+}
+
+void Cpu::pace(){
+    if (this->realtime_hz == 0){
+        return;
+    }
+    uint64_t elapsed = this->tick - this->realtime_tick;
+    uint64_t due = this->realtime_ns + elapsed / this->realtime_hz * 1000000000ull
+                   + elapsed % this->realtime_hz * 1000000000ull / this->realtime_hz;
+    if (due > monotonic_ns()){
+        struct timespec ts{};
+        ts.tv_sec = (time_t)(due / 1000000000ull);
+        ts.tv_nsec = (long)(due % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+    }
+}
+
+void Cpu::skipHalt(){
+    // HALT repeats a 4 T-state M1 cycle, incrementing R each time
+    uint64_t deadline = this->scheduler.deadline();
+    if (deadline <= this->tick){
+        return;
+    }
+    uint64_t cycles = (deadline - this->tick + 3) / 4;
+    this->tick += cycles * 4;
+    uint8_t r1 = (this->special_registers.r & 0b10000000);
+    uint8_t r7 = (this->special_registers.r + cycles) & 0b01111111;
+    this->special_registers.r = r1 | r7;
+    this->metrics.mcycles[Metrics::MCYCLE_HALT] += cycles;
+    this->metrics.halted_tstates += cycles * 4;
+    uint64_t before = this->metrics.instructions;
+    this->metrics.instructions += cycles;
+    if ((before >> 16) != (this->metrics.instructions >> 16) && this->metrics_publisher != nullptr){
+        this->metrics_publisher->publish(this->metrics, this->tick);
+    }
+    this->pace();
+}
+
+void Cpu::drainBusWorker(){
+    uint64_t waits = this->bus_worker->drain();
+    this->tick += waits;
+    this->metrics.wait_cycles += waits;
+}
+
+bool Cpu::busRequested(){
+    if (this->bus_worker != nullptr){
+        return this->bus_worker->busRequested();
+    }
+    return ! this->bus->getInput(Bus::Z80_PIN_I_BUSRQ);
+}
+
+void Cpu::samplePins(){
+    this->syncBus();
+    this->pin_reset_low = !this->bus->getInput(Bus::Z80_PIN_I_RESET);
+    this->pin_nmi_low = !this->bus->getInput(Bus::Z80_PIN_I_NMI);
+    this->pin_int_low = !this->bus->getInput(Bus::Z80_PIN_I_INT);
+    this->pin_busrq_low = !this->bus->getInput(Bus::Z80_PIN_I_BUSRQ);
+}
+
+void Cpu::releaseBus(){
+    // Posted cycles come before BUSACK
+    this->syncBus();
+    this->pin_busrq_low = false;
+    // Control outputs inactive and the data bus an input. The adapter board latches the
+    // address lines, so they keep the last address instead of floating.
+    this->bus->setDataEnd();
+    this->bus->pin_o_mreq = Bus::PIN_HIGH;
+    this->bus->pin_o_iorq = Bus::PIN_HIGH;
+    this->bus->pin_o_rd = Bus::PIN_HIGH;
+    this->bus->pin_o_wr = Bus::PIN_HIGH;
+    this->bus->pin_o_busack = Bus::PIN_LOW;
+    this->bus->syncControl();
+    this->metrics.bus_releases++;
+    uint64_t start = this->tick;
+
+    while (true){
+        // A master may ask again from busGranted, e.g. a DMA in byte mode. That waits for the next M-cycle.
+        std::vector<BusMaster*> masters;
+        masters.swap(this->bus_requests);
+        for (BusMaster* master : masters){
+            master->busGranted(this);
         }
-        if (this->halt) {
-            Mcycle::m1halt(this);
-        } else if (this->enable_virtual_memory){
-            Mcycle::m1vm(this);
-        } else {
-            Mcycle::m1t1(this);
-            Mcycle::m1t2(this);
-            Mcycle::m1t3(this);
-            Mcycle::m1t4(this);
+        if (this->pin_poll_interval == 0 || this->bus->getInput(Bus::Z80_PIN_I_BUSRQ)){
+            break;
         }
-        this->opCode.execute(this->executing);
-
-        // Disable / Enable interrupt
-        if (this->waitingEI > 0){
-            this->waitingEI--;
-            if (this->waitingEI == 0){
-                Log::general(this, "INT enabled");
-                this->iff1 = true;
-                this->iff2 = true;
-            }
+        // An external master holds BUSRQ low. The clock keeps running.
+        this->bus->waitClockRising();
+        this->bus->waitClockFalling();
+        this->tick++;
+    }
+
+    this->metrics.busack_tstates += this->tick - start;
+    if (this->bus_worker != nullptr){
+        this->bus_worker->busReleased();
+    }
+    this->bus->pin_o_busack = Bus::PIN_HIGH;
+    this->bus->syncControl();
+}
+
+void Cpu::saveSnapshot(const char* path){
+    Snapshot::save(this, path);
+}
+
+void Cpu::saveSnapshotDelta(const char* path){
+    Snapshot::saveDelta(this, path);
+}
+
+void Cpu::loadSnapshot(const char* path){
+    Snapshot::load(this, path);
+}
+
+void Cpu::instructionCycle(){
+    while(!this->stopped){
+        this->step();
+    }
+}
+
+void Cpu::step(){
+    if (this->canSkipHalt()){
+        this->skipHalt();
+    }
+    if (this->tick >= this->scheduler.deadline()){
+        this->scheduler.run(this->tick);
+    }
+    // Requests made by emulated devices since the last bus cycle
+    if (! this->bus_requests.empty() || this->pin_busrq_low){
+        this->releaseBus();
+    }
+    if (this->pin_poll_interval == 1){
+        this->syncBus();
+        this->pin_reset_low = !this->bus->getInput(Bus::Z80_PIN_I_RESET);
+    }
+    if (this->pin_reset_low){
+        this->pin_reset_low = false;
+        while(!this->bus->getInput(Bus::Z80_PIN_I_RESET));
+
+        const double time = static_cast<double>(clock() - this->last_reset) / CLOCKS_PER_SEC * 1000.0;
+        if (time > 1000){
+            printf("Resetting\n");
+            Log::general(this, "Reset");
+            this->reset();
+            this->last_reset = clock();
         }
-        if (this->waitingDI > 0){
-            this->waitingDI--;
-            if (this->waitingDI == 0){
-                Log::general(this, "INT disabled");
-                this->iff1 = false;
-                this->iff2 = false;
-            }
+    }
+    if (this->debug_active && this->debug.check()){
+        // Stopped in front of the instruction. The debugger decides when to go on.
+        return;
+    }
+    if (this->idle_detection && this->enable_virtual_memory && this->pin_poll_interval != 1 && ! this->debug_active){
+        this->idle_loop.check(this->special_registers.pc);
+    }
+    bool bdos_wait = false;
+    if (this->emulate_cpm_bdos_call && this->special_registers.pc == Cpm::BDOS_ENTRY && ! this->halt){
+        // CP/M BDOS call, however the program got here. The ret at BDOS_ENTRY follows.
+        bdos_wait = ! this->opCode.executeBdos();
+        if (this->stopped){
+            return;
         }
+    }
+    if (this->halt || bdos_wait) {
+        // Waiting for the console idles like HALT, at BDOS_ENTRY
+        Mcycle::m1halt(this);
+    } else if (this->enable_virtual_memory && ! this->onBus(this->special_registers.pc)){
+        Mcycle::m1vm(this);
+    } else {
+        Mcycle::m1t1(this);
+        Mcycle::m1t2(this);
+        Mcycle::m1t3(this);
+        Mcycle::m1t4(this);
+    }
+    this->opCode.execute(this->executing);
+    if (this->emulate_cpm_bdos_call && this->special_registers.pc == 0x0000){
+        // CP/M Warm boot
+        Log::general(this, "CP/M Warm boot");
+        this->stopped = true;
+    }
 
-        // NMI
-        if ((!this->bus->getInput(Bus::Z80_PIN_I_NMI))){
-            Log::general(this, "NMI-activated");
-            this->iff2 = this->iff1;
+    // Disable / Enable interrupt
+    if (this->waitingEI > 0){
+        this->waitingEI--;
+        if (this->waitingEI == 0){
+            Log::general(this, "INT enabled");
+            this->iff1 = true;
+            this->iff2 = true;
+        }
+    }
+    if (this->waitingDI > 0){
+        this->waitingDI--;
+        if (this->waitingDI == 0){
+            Log::general(this, "INT disabled");
             this->iff1 = false;
+            this->iff2 = false;
+        }
+    }
 
-            uint16_t nmi_jump_addr = 0x0066;
-            this->special_registers.sp--;
-            Mcycle::m3(this, this->special_registers.sp, this->special_registers.pc >> 8);
-            this->special_registers.sp--;
-            Mcycle::m3(this, this->special_registers.sp, this->special_registers.pc & 0xff);
-            this->special_registers.pc = nmi_jump_addr;
+    if (this->pin_poll_interval == 1){
+        // After the writes of the instruction, which may have cleared a request
+        this->syncBus();
+        this->pin_nmi_low = !this->bus->getInput(Bus::Z80_PIN_I_NMI);
+        this->pin_int_low = !this->bus->getInput(Bus::Z80_PIN_I_INT);
+        if (this->enable_virtual_memory){
+            // Host memory may leave no bus M-cycle to sample BUSRQ at. Granted before the next instruction.
+            this->pin_busrq_low = !this->bus->getInput(Bus::Z80_PIN_I_BUSRQ);
         }
-        // INT
-        if ((!this->bus->getInput(Bus::Z80_PIN_I_INT)) && this->iff1){
-            Log::general(this, "INT-activated");
-            if (! this->bus->getInput(Bus::Z80_PIN_I_BUSRQ)){
-                Log::general(this, "but BUSRQ is low.");
-            } else {
-                Mcycle::int_m1t1t2t3(this);
-                Mcycle::m1t4(this);
-
-                Mcycle::m3(this, this->special_registers.sp - 2, this->special_registers.pc & 0xff);
-                Mcycle::m3(this, this->special_registers.sp - 1, this->special_registers.pc >> 8);
-                this->special_registers.sp -= 2;
-
-                uint8_t int_vector = this->executing;
-                Log::io_read(this, this->special_registers.pc, int_vector);
-                switch (this->interrupt_mode) {
-                    case 0:
-                        this->opCode.execute(int_vector);
-                        break;
-                    case 1:
-                        this->special_registers.pc = 0x0038;
-                        break;
-                    case 2: {
-                        uint16_t int_vector_pointer = (this->special_registers.i << 8) + (int_vector & 0b11111110);
-                        uint16_t int_vector_addr =
-                                Mcycle::m2(this, int_vector_pointer) +
-                                (Mcycle::m2(this, int_vector_pointer + 1) << 8);
-                        this->special_registers.pc = int_vector_addr;
-                        break;
-                    }
-                    default:
-                        throw std::runtime_error("Invalid interrupt mode.");
-                }
-            }
+    }
+    // NMI
+    if (this->pin_nmi_low){
+        this->pin_nmi_low = false;
+        Log::general(this, "NMI-activated");
+        this->metrics.nmi_taken++;
+        this->halt = false;
+        this->iff2 = this->iff1;
+        this->iff1 = false;
+
+        uint16_t nmi_jump_addr = 0x0066;
+        this->special_registers.sp--;
+        Mcycle::m3(this, this->special_registers.sp, this->special_registers.pc >> 8);
+        this->special_registers.sp--;
+        Mcycle::m3(this, this->special_registers.sp, this->special_registers.pc & 0xff);
+        this->special_registers.pc = nmi_jump_addr;
+    }
+    // INT. Emulated devices come first in the daisy chain, then the bus.
+    InterruptSource* source = this->iff1 ? this->io_map.interruptRequest(this->tick) : nullptr;
+    bool pin_int = this->pin_int_low && this->iff1;
+    if (pin_int && this->pin_poll_interval != 1){
+        // Sampled a while ago. An acknowledge cycle nobody answers would read 0xff.
+        this->syncBus();
+        pin_int = this->pin_int_low = !this->bus->getInput(Bus::Z80_PIN_I_INT);
+    }
+    if (source != nullptr || pin_int){
+        Log::general(this, "INT-activated");
+        this->metrics.int_taken++;
+        this->halt = false;
+        // Held off until the handler runs EI, as on the real part
+        this->iff1 = false;
+        this->iff2 = false;
+        if (source != nullptr){
+            Mcycle::int_m1vm(this, this->io_map.interruptAcknowledge(source, this->tick));
+        } else {
+            Mcycle::int_m1t1t2t3(this);
+            Mcycle::m1t4(this);
         }
 
-        instructions++;
-        if (instructions == 1000 * 1000){
-            const double time = static_cast<double>(clock() - start) / CLOCKS_PER_SEC * 1000.0;
-            printf("1M instructions in %lf msec.\n", time);
-            start = clock();
-            instructions = 0;
+        Mcycle::m3(this, this->special_registers.sp - 2, this->special_registers.pc & 0xff);
+        Mcycle::m3(this, this->special_registers.sp - 1, this->special_registers.pc >> 8);
+        this->special_registers.sp -= 2;
+
+        uint8_t int_vector = this->executing;
+        Log::io_read(this, this->special_registers.pc, int_vector);
+        switch (this->interrupt_mode) {
+            case 0:
+                this->opCode.execute(int_vector);
+                break;
+            case 1:
+                this->special_registers.pc = 0x0038;
+                break;
+            case 2: {
+                uint16_t int_vector_pointer = (this->special_registers.i << 8) + (int_vector & 0b11111110);
+                uint16_t int_vector_addr =
+                        Mcycle::m2(this, int_vector_pointer) +
+                        (Mcycle::m2(this, int_vector_pointer + 1) << 8);
+                this->special_registers.pc = int_vector_addr;
+                break;
+            }
+            default:
+                throw std::runtime_error("Invalid interrupt mode.");
         }
     }
-    #pragma clang diagnostic pop
-}
\ No newline at end of file
+
+    this->metrics.instructions++;
+    if ((this->metrics.instructions & 0xffff) == 0 && this->metrics_publisher != nullptr){
+        this->metrics_publisher->publish(this->metrics, this->tick);
+    }
+}
@@ -3,31 +3,98 @@
 #ifndef Z80EMU_Z80_HPP
 #define Z80EMU_Z80_HPP
 #include <array>
+#include <ctime>
+#include <functional>
+#include <ostream>
+#include <vector>
 #include "registers.hpp"
 #include "special_registers.hpp"
 #include "opcode.hpp"
+#include "metrics.hpp"
+#include "snapshot.hpp"
+#include "debug.hpp"
+#include "io.hpp"
+#include "scheduler.hpp"
+#include "idle.hpp"
 #include "bus/pigpio_bus.hpp"
 
+class Bdos;
+class BusWorker;
+class Console;
+class Mmu;
+
 class Cpu
 {
 public:
     explicit Cpu(Bus *bus);
+    // page_table points into the instance
+    Cpu(const Cpu&) = delete;
+    Cpu& operator=(const Cpu&) = delete;
+
+    static const int PAGE_SHIFT = 12;
+    static const uint16_t PAGE_MASK = 0x0fff;
+    static const int PAGE_COUNT = 16;
 
     Bus *bus;
+    // Memory and I/O cycles on the bus go through this thread when set
+    BusWorker* bus_worker = nullptr;
     OpCode opCode;
     SpecialRegisters special_registers;
     Registers registers;
     Registers registers_alternate;
 
     bool enable_virtual_memory = false;
-    std::array<uint8_t, 32> virtual_memory{
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    };
+    std::array<uint8_t, 0x10000> virtual_memory{};
+    // Host address of each 4KB page of the address space. Into virtual_memory unless mmu maps banks in.
+    std::array<uint8_t*, PAGE_COUNT> page_table{};
+    Mmu* mmu = nullptr;
+    // Host memory seen at addr
+    uint8_t& memory(uint16_t addr){
+        return this->page_table[addr >> PAGE_SHIFT][addr & PAGE_MASK];
+    }
+    // Maps every page to virtual_memory again
+    void resetPageTable();
+    // Pages of virtual_memory written since the last checkpoint
+    PageBitmap dirty_pages{};
+    // 256-byte pages that stay on the bus with host memory: memory mapped I/O of the board
+    PageBitmap bus_pages{};
+    bool has_bus_pages = false;
+    // Leaves from..to, rounded out to whole 256-byte pages, on the bus
+    void mapToBus(uint16_t from, uint16_t to);
+    bool onBus(uint16_t addr) const{
+        return this->has_bus_pages && (this->bus_pages[addr >> 14] >> ((addr >> 8) & 0x3f) & 1) != 0;
+    }
+    // Any of count bytes from addr
+    bool onBus(uint16_t addr, size_t count) const;
+    // Reads board memory into host memory with real memory cycles, for hybrid mode. Counters
+    // are left as they were, since the program never made these accesses.
+    void copyFromBus(uint16_t from, uint32_t size);
+    // T-state of the last checkpoint. Deltas apply only on top of it.
+    uint64_t checkpoint_tick = 0;
     // refs: https://www.seasip.info/Cpm/bdos.html
     bool emulate_cpm_bdos_call = false;
+    // Disk functions of the emulated BDOS. Only console output works when null.
+    Bdos* bdos = nullptr;
+
+    // Ports served by emulated devices. The rest reach the bus.
+    IoMap io_map;
+    // Device events by T-state. step() runs them once tick reaches their deadline.
+    Scheduler scheduler;
+
+    // Elapsed T-states
+    uint64_t tick = 0;
 
-    uint32_t tick = 0;
+    // Trace output of this instance. Nothing is written when null.
+    std::ostream* log_sink = nullptr;
+    Metrics metrics;
+    MetricsPublisher* metrics_publisher = nullptr;
+
+    // Polling loops that change nothing. Fed by the M-cycles; looked at only with setIdleDetection.
+    IdleLoop idle_loop;
+
+    // Set while a debugger is attached. debug is not looked at otherwise.
+    bool debug_active = false;
+    Debug debug;
 
     bool iff1 = false;
     bool iff2 = false;
@@ -44,9 +111,89 @@ public:
 
     uint8_t executing = 0;
 
+    // Set by a CP/M warm boot when emulate_cpm_bdos_call is enabled
+    bool stopped = false;
+    // Receives BDOS console output. It goes to console, or stdout without one, when empty.
+    std::function<void(uint8_t)> console_output;
+    // Console input and buffered output. BDOS input functions see end of input when null.
+    Console* console = nullptr;
+
     void reset();
 
     void instructionCycle();
+    void step();
+
+    void consoleOutput(uint8_t chr);
+
+    // An emulated master wants the bus. It gets it at the end of the current M-cycle.
+    void busRequest(BusMaster* master){
+        this->bus_requests.push_back(master);
+    }
+    // End of an M-cycle on the bus: BUSRQ is sampled here, as on the real part
+    void busRequestPoint(){
+        if (this->bus->pin_o_busack == Bus::PIN_LOW){
+            // A master is on the bus already
+            return;
+        }
+        if (! this->bus_requests.empty() || this->pin_busrq_low
+                || (this->pin_poll_interval == 1 && this->busRequested())){
+            this->releaseBus();
+        }
+    }
+    // Waits for the writes posted to bus_worker. Any other use of bus comes after this.
+    void syncBus(){
+        if (this->bus_worker != nullptr){
+            this->drainBusWorker();
+        }
+    }
+    // Floats the bus and asserts BUSACK until emulated masters are done and BUSRQ is high
+    void releaseBus();
+
+    // T-states between samples of the RESET, NMI and INT pins. 1 samples them around every
+    // instruction. Larger values sample from a scheduler event instead, which saves the GPIO
+    // reads at the cost of latency. 0 never samples: for buses without external devices.
+    void setPinPolling(uint64_t interval);
+    // Paces the emulation to a clock_hz CPU clock: a HALT skipped up to the next event sleeps
+    // the host until that T-state is due. 0 runs as fast as possible.
+    void setRealtime(uint64_t clock_hz);
+    // Skips or sleeps through polling loops that wait for a device or the host. Works like the
+    // HALT skip, so it needs host memory and pins that are not read every instruction.
+    void setIdleDetection(bool enable);
+    // With realtime pacing, sleeps until the host clock reaches tick
+    void pace();
+
+    void saveSnapshot(const char* path);
+    // Pages written since the previous snapshot or delta only
+    void saveSnapshotDelta(const char* path);
+    void loadSnapshot(const char* path);
+
+private:
+    clock_t last_reset = clock();
+    uint64_t pin_poll_interval = 1;
+    // Bumped by setPinPolling so an older sampling event stops rescheduling itself
+    uint64_t pin_poll_generation = 0;
+    bool pin_reset_low = false;
+    bool pin_nmi_low = false;
+    bool pin_int_low = false;
+    bool pin_busrq_low = false;
+    bool idle_detection = false;
+    uint64_t realtime_hz = 0;
+    // T-state and host time at which realtime pacing started
+    uint64_t realtime_tick = 0;
+    uint64_t realtime_ns = 0;
+    std::vector<BusMaster*> bus_requests;
+
+    void samplePins();
+    void drainBusWorker();
+    // BUSRQ pin, or what the bus worker saw at the end of its last cycle
+    bool busRequested();
+    // Halted with nothing to watch but the scheduler: counts the HALT cycles up to its next event at once
+    bool canSkipHalt() const{
+        return this->halt && this->enable_virtual_memory && this->pin_poll_interval != 1 && ! this->debug_active
+               && this->waitingEI == 0 && this->waitingDI == 0 && this->scheduler.deadline() != Scheduler::NEVER;
+    }
+    void skipHalt();
+    void pinPollEvent(uint64_t generation, uint64_t now);
 };
 
 #endif //Z80EMU_Z80_HPP
@@ -0,0 +1,165 @@
+#include "ctc.hpp"
+#include "cpu.hpp"
+
+Ctc::Ctc(){
+    for (int i = 0; i < CHANNELS; i++){
+        this->channels[i].ctc = this;
+        this->channels[i].index = i;
+    }
+}
+
+void Ctc::attach(Cpu* _cpu, uint8_t _base){
+    this->cpu = _cpu;
+    this->base = _base;
+    _cpu->io_map.attach(_base, CHANNELS, this);
+    for (Channel& channel : this->channels){
+        _cpu->io_map.addInterruptSource(&channel);
+    }
+}
+
+void Ctc::reset(){
+    // Channels stop and interrupts are disabled. The vector and time constants are kept.
+    for (Channel& channel : this->channels){
+        channel.control = RESET;
+        channel.expect_constant = false;
+        channel.running = false;
+        channel.waiting_trigger = false;
+        channel.next_constant = 0;
+        channel.generation++;
+        channel.int_pending = false;
+        channel.in_service = false;
+    }
+}
+
+void Ctc::refresh(uint64_t now){
+    if (this->cpu != nullptr){
+        this->cpu->io_map.updateInterrupt(now);
+    }
+}
+
+uint8_t Ctc::Channel::intAcknowledge(uint64_t){
+    this->int_pending = false;
+    this->in_service = true;
+    // Bits 2-1 name the channel
+    return this->ctc->vector | (this->index << 1);
+}
+
+uint8_t Ctc::ioRead(Cpu* _cpu, uint16_t port){
+    Channel* channel = &this->channels[(uint8_t)(port - this->base) & 0x03];
+    if (channel->running && ! (channel->control & COUNTER_MODE)){
+        _cpu->idle_loop.clockedRead();
+    }
+    return this->value(channel, _cpu->tick);
+}
+
+void Ctc::ioWrite(Cpu* _cpu, uint16_t port, uint8_t data){
+    Channel* channel = &this->channels[(uint8_t)(port - this->base) & 0x03];
+    this->write(channel, data, _cpu->tick);
+    this->refresh(_cpu->tick);
+}
+
+void Ctc::write(Channel* channel, uint8_t data, uint64_t now){
+    if (channel->expect_constant){
+        channel->expect_constant = false;
+        uint16_t constant = (data == 0) ? 256 : data;
+        if (channel->running && !(channel->control & RESET)){
+            // A running channel takes the new constant at its next zero count
+            channel->next_constant = constant;
+            return;
+        }
+        channel->control &= ~RESET;
+        channel->time_constant = constant;
+        channel->counter = constant;
+        channel->generation++;
+        if (channel->control & COUNTER_MODE){
+            channel->running = true;
+        } else if (channel->control & TRIGGER_START){
+            channel->waiting_trigger = true;
+        } else {
+            this->startTimer(channel, now);
+        }
+        return;
+    }
+    if (!(data & CONTROL)){
+        // Interrupt vector, written through channel 0
+        if (channel->index == 0){
+            this->vector = data & 0xf8;
+        }
+        return;
+    }
+    channel->control = data;
+    channel->expect_constant = (data & TIME_CONSTANT) != 0;
+    if (data & RESET){
+        channel->running = false;
+        channel->waiting_trigger = false;
+        channel->next_constant = 0;
+        channel->generation++;
+    }
+    if (!(data & INTERRUPT)){
+        channel->int_pending = false;
+    }
+}
+
+void Ctc::startTimer(Channel* channel, uint64_t when){
+    channel->running = true;
+    channel->waiting_trigger = false;
+    channel->start = when;
+    this->postZero(channel);
+}
+
+void Ctc::postZero(Channel* channel){
+    if (this->cpu == nullptr){
+        return;
+    }
+    uint64_t generation = channel->generation;
+    uint64_t when = channel->start + channel->prescale() * channel->time_constant;
+    this->cpu->scheduler.post(when, [this, channel, generation, when](uint64_t){
+        if (generation == channel->generation){
+            this->zero(channel, when);
+        }
+    });
+}
+
+void Ctc::zero(Channel* channel, uint64_t when){
+    // Reload, then ZC/TO. Timer periods count from when the zero was due, not when the event ran.
+    if (channel->next_constant != 0){
+        channel->time_constant = channel->next_constant;
+        channel->next_constant = 0;
+    }
+    channel->counter = channel->time_constant;
+    if (!(channel->control & COUNTER_MODE)){
+        channel->start = when;
+        this->postZero(channel);
+    }
+    if (channel->control & INTERRUPT){
+        channel->int_pending = true;
+        this->refresh(when);
+    }
+    if (this->cascade && channel->index < CHANNELS - 1){
+        this->trigger(channel->index + 1, when);
+    }
+}
+
+void Ctc::trigger(int index, uint64_t now){
+    Channel* channel = &this->channels[index];
+    if (channel->waiting_trigger){
+        // A timer waiting for its trigger starts with this edge
+        this->startTimer(channel, now);
+        return;
+    }
+    if (! channel->running || !(channel->control & COUNTER_MODE)){
+        return;
+    }
+    if (--channel->counter == 0){
+        this->zero(channel, now);
+    }
+}
+
+uint8_t Ctc::value(const Channel* channel, uint64_t now){
+    if (! channel->running || (channel->control & COUNTER_MODE)){
+        return (uint8_t)channel->counter;
+    }
+    uint64_t elapsed = (now - channel->start) / channel->prescale();
+    // The down counter: time_constant right after a reload, 256 reads as 0
+    return (uint8_t)(channel->time_constant - elapsed % channel->time_constant);
+}
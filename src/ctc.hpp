@@ -0,0 +1,88 @@
+#ifndef Z80EMU_CTC_HPP
+#define Z80EMU_CTC_HPP
+
+#include <cstdint>
+#include "io.hpp"
+
+class Cpu;
+
+// Z80 CTC: four counter/timer channels on consecutive ports.
+//
+// Timers count the CPU clock, so the T-state counter drives them: each running timer posts a
+// scheduler event at its next zero count instead of anything looking at it per instruction.
+// Counters count pulses from trigger(), or from the previous channel with cascade set.
+// Every channel is its own link in the interrupt daisy chain, channel 0 first, so a higher
+// channel's service can be interrupted by a lower numbered one as on the real part.
+// Registers follow the Zilog Z80 CTC technical manual.
+class Ctc : public IoDevice {
+public:
+    static const int CHANNELS = 4;
+
+    // Channel control word bits
+    static const uint8_t CONTROL = 0x01;
+    static const uint8_t RESET = 0x02;
+    static const uint8_t TIME_CONSTANT = 0x04;
+    static const uint8_t TRIGGER_START = 0x08;
+    static const uint8_t PRESCALE_256 = 0x20;
+    static const uint8_t COUNTER_MODE = 0x40;
+    static const uint8_t INTERRUPT = 0x80;
+
+    Ctc();
+    Ctc(const Ctc&) = delete;
+    Ctc& operator=(const Ctc&) = delete;
+
+    // Claims four ports from base of cpu's IoMap and joins its daisy chain
+    void attach(Cpu* cpu, uint8_t base);
+    void reset();
+    // Active edge on CLK/TRG of channel at T-state now
+    void trigger(int channel, uint64_t now);
+    // ZC/TO of channels 0-2 drive CLK/TRG of the next channel, as wired on many boards
+    bool cascade = false;
+
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+
+private:
+    class Channel : public InterruptSource {
+    public:
+        Ctc* ctc = nullptr;
+        int index = 0;
+        uint8_t control = RESET;
+        // 1-256
+        uint16_t time_constant = 256;
+        // Loaded at the next zero count when written while running
+        uint16_t next_constant = 0;
+        bool expect_constant = false;
+        bool running = false;
+        bool waiting_trigger = false;
+        // Timer mode: the T-state of the last reload
+        uint64_t start = 0;
+        // Counter mode: pulses left
+        uint16_t counter = 0;
+        // Bumped on reprogramming so events of the previous setting are ignored
+        uint64_t generation = 0;
+        bool int_pending = false;
+        bool in_service = false;
+
+        bool intPending(uint64_t) override{ return this->int_pending && ! this->in_service; }
+        uint8_t intAcknowledge(uint64_t) override;
+        bool inService() override{ return this->in_service; }
+        void intReturn() override{ this->in_service = false; }
+
+        uint64_t prescale() const{ return (this->control & PRESCALE_256) ? 256 : 16; }
+    };
+
+    Channel channels[CHANNELS];
+    Cpu* cpu = nullptr;
+    uint8_t base = 0;
+    uint8_t vector = 0;
+
+    void write(Channel* channel, uint8_t data, uint64_t now);
+    void startTimer(Channel* channel, uint64_t when);
+    void postZero(Channel* channel);
+    void zero(Channel* channel, uint64_t when);
+    uint8_t value(const Channel* channel, uint64_t now);
+    void refresh(uint64_t now);
+};
+
+#endif //Z80EMU_CTC_HPP
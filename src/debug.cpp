@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdio>
+#include "debug.hpp"
+#include "cpu.hpp"
+
+static const char* typeName(uint8_t type){
+    switch (type){
+        case Debug::WATCH_READ:     return "read";
+        case Debug::WATCH_WRITE:    return "write";
+        case Debug::WATCH_EXECUTE:  return "execute";
+        default:                    return "access";
+    }
+}
+
+Debug::Debug(Cpu* _cpu) : cpu(_cpu) {}
+
+void Debug::setBreakpoint(uint16_t addr, bool enable){
+    if (enable){
+        this->breakpoints[addr >> 6] |= (uint64_t)1 << (addr & 0x3f);
+    } else {
+        this->breakpoints[addr >> 6] &= ~((uint64_t)1 << (addr & 0x3f));
+        this->updateActive();
+    }
+}
+
+void Debug::addWatchpoint(uint16_t addr, uint16_t length, uint8_t type, uint8_t action, Callback callback){
+    if (length == 0){
+        return;
+    }
+    this->watchpoints.push_back({addr, length, type, action, std::move(callback)});
+    this->updatePages();
+    this->cpu->debug_active = true;
+}
+
+void Debug::removeWatchpoint(uint16_t addr, uint16_t length, uint8_t type){
+    auto it = std::find_if(this->watchpoints.begin(), this->watchpoints.end(), [&](const Watchpoint& w){
+        return w.addr == addr && w.length == length && w.type == type;
+    });
+    if (it != this->watchpoints.end()){
+        this->watchpoints.erase(it);
+        this->updatePages();
+        this->updateActive();
+    }
+}
+
+bool Debug::check(){
+    bool resuming = this->resuming;
+    this->resuming = false;
+    this->instruction_pc = this->cpu->special_registers.pc;
+
+    if (this->watch_hit){
+        // The access happened in the instruction that just finished
+        this->watch_hit = false;
+        this->stop_reason = STOP_WATCH;
+        return true;
+    }
+    if (this->single_step && ! resuming){
+        this->single_step = false;
+        this->stop_reason = STOP_STEP;
+        return true;
+    }
+    uint16_t pc = this->cpu->special_registers.pc;
+    if (! resuming && this->isBreakpoint(pc)){
+        this->stop_reason = STOP_BREAKPOINT;
+        return true;
+    }
+    if (! resuming && this->isWatched(pc)){
+        for (const Watchpoint& w : this->watchpoints){
+            uint8_t opcode = this->cpu->enable_virtual_memory ? this->cpu->memory(pc) : 0;
+            if (this->hit(w, pc, WATCH_EXECUTE, opcode)){
+                // Stops in front of the instruction rather than after it
+                this->watch_hit = false;
+                this->stop_reason = STOP_WATCH;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Debug::access(uint16_t addr, uint8_t type, uint8_t data){
+    if (! this->cpu->debug_active){
+        // Re-executing history
+        return;
+    }
+    for (const Watchpoint& w : this->watchpoints){
+        this->hit(w, addr, type, data);
+    }
+}
+
+void Debug::resume(bool _single_step){
+    this->stop_reason = STOP_NONE;
+    this->single_step = _single_step;
+    this->resuming = true;
+    this->watch_hit = false;
+}
+
+bool Debug::hit(const Watchpoint& w, uint16_t addr, uint8_t type, uint8_t data){
+    if (! (w.type & type) || (uint16_t)(addr - w.addr) >= w.length){
+        return false;
+    }
+    if (w.action & ACTION_LOG){
+        fprintf(stderr, "watch %s %04x: %02x at pc:%04x T-state %llu\n", typeName(type), addr, data,
+                this->instruction_pc, (unsigned long long)this->cpu->tick);
+    }
+    if ((w.action & ACTION_CALLBACK) && w.callback){
+        w.callback(this->cpu, addr, type, data);
+    }
+    if (w.action & ACTION_PAUSE){
+        this->watch_hit = true;
+        this->watch_addr = addr;
+        this->watch_type = w.type;
+        return true;
+    }
+    return false;
+}
+
+void Debug::updateActive(){
+    if (this->attached || this->single_step || ! this->watchpoints.empty()){
+        return;
+    }
+    for (uint64_t word : this->breakpoints){
+        if (word != 0){
+            return;
+        }
+    }
+    this->cpu->debug_active = false;
+}
+
+void Debug::updatePages(){
+    this->watch_pages.fill(0);
+    for (const Watchpoint& w : this->watchpoints){
+        uint32_t last = (uint32_t)w.addr + w.length - 1;
+        for (uint32_t page = w.addr >> 8; page <= (last >> 8); page++){
+            // Ranges past ffff wrap around
+            uint8_t p = page & 0xff;
+            this->watch_pages[p >> 6] |= (uint64_t)1 << (p & 0x3f);
+        }
+    }
+}
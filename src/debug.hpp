@@ -0,0 +1,92 @@
+#ifndef Z80EMU_DEBUG_HPP
+#define Z80EMU_DEBUG_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "snapshot.hpp"
+
+class Cpu;
+
+// Breakpoints and watchpoints of one Cpu.
+// Breakpoints and execute watchpoints are checked per instruction only while Cpu::debug_active
+// is set. Memory accesses test one bit per 256-byte page; only pages with a watchpoint take the
+// slow path that compares ranges.
+class Debug {
+public:
+    static const uint8_t STOP_NONE = 0;
+    static const uint8_t STOP_BREAKPOINT = 1;
+    static const uint8_t STOP_STEP = 2;
+    static const uint8_t STOP_WATCH = 3;
+
+    static const uint8_t WATCH_READ = 1;
+    static const uint8_t WATCH_WRITE = 2;
+    static const uint8_t WATCH_ACCESS = WATCH_READ | WATCH_WRITE;
+    static const uint8_t WATCH_EXECUTE = 4;
+
+    // What a watchpoint hit does. Combinable.
+    static const uint8_t ACTION_PAUSE = 1;
+    static const uint8_t ACTION_LOG = 2;
+    static const uint8_t ACTION_CALLBACK = 4;
+
+    typedef std::function<void(Cpu* cpu, uint16_t addr, uint8_t type, uint8_t data)> Callback;
+
+    struct Watchpoint {
+        uint16_t addr;
+        uint16_t length;
+        uint8_t type;
+        uint8_t action;
+        Callback callback;
+    };
+
+    explicit Debug(Cpu* cpu);
+
+    void setBreakpoint(uint16_t addr, bool enable);
+    bool isBreakpoint(uint16_t addr){
+        return (this->breakpoints[addr >> 6] >> (addr & 0x3f)) & 1;
+    }
+
+    // Watches [addr, addr + length). Adding one turns on Cpu::debug_active.
+    void addWatchpoint(uint16_t addr, uint16_t length, uint8_t type,
+                       uint8_t action = ACTION_PAUSE, Callback callback = nullptr);
+    // Removing the last one turns Cpu::debug_active off unless a breakpoint, a step or a debugger remains
+    void removeWatchpoint(uint16_t addr, uint16_t length, uint8_t type);
+    bool isWatched(uint16_t addr){
+        return (this->watch_pages[addr >> 14] >> ((addr >> 8) & 0x3f)) & 1;
+    }
+
+    // Called by Cpu::step before fetching. true stops the machine in front of the instruction.
+    bool check();
+    // Slow path of a memory access to a watched page
+    void access(uint16_t addr, uint8_t type, uint8_t data);
+
+    // Clears the stop reason. The next check ignores a breakpoint at the current pc.
+    void resume(bool single_step);
+    // Clears Cpu::debug_active once there is nothing left to stop at
+    void updateActive();
+
+    uint8_t stop_reason = STOP_NONE;
+    uint16_t watch_addr = 0;
+    uint8_t watch_type = 0;
+    // Start of the instruction being executed
+    uint16_t instruction_pc = 0;
+    // Set while a debugger is attached, which keeps Cpu::debug_active on
+    bool attached = false;
+
+private:
+    Cpu* cpu;
+    // One bit per address
+    std::array<uint64_t, 0x10000 / 64> breakpoints{};
+    std::vector<Watchpoint> watchpoints;
+    // Pages that overlap a watchpoint
+    PageBitmap watch_pages{};
+    bool single_step = false;
+    bool resuming = false;
+    bool watch_hit = false;
+
+    bool hit(const Watchpoint& watchpoint, uint16_t addr, uint8_t type, uint8_t data);
+    void updatePages();
+};
+
+#endif //Z80EMU_DEBUG_HPP
@@ -0,0 +1,216 @@
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "disk.hpp"
+
+IdeDisk::IdeDisk(const char* path){
+    int fd = open(path, O_RDWR);
+    if (fd < 0){
+        throw std::runtime_error(std::string("Cannot open disk image ") + path);
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)SECTOR_SIZE){
+        close(fd);
+        throw std::runtime_error(std::string("Disk image too small ") + path);
+    }
+    this->sector_count = (size_t)st.st_size / SECTOR_SIZE;
+    this->image_size = this->sector_count * SECTOR_SIZE;
+    void* addr = mmap(nullptr, this->image_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED){
+        throw std::runtime_error(std::string("Cannot map disk image ") + path);
+    }
+    this->image = static_cast<uint8_t*>(addr);
+    this->buildIdentify();
+}
+
+IdeDisk::~IdeDisk(){
+    this->flush();
+    munmap(this->image, this->image_size);
+}
+
+void IdeDisk::attach(IoMap* map, uint8_t _base){
+    this->base = _base;
+    map->attach(_base, 8, this);
+}
+
+void IdeDisk::flush(){
+    msync(this->image, this->image_size, MS_SYNC);
+}
+
+uint32_t IdeDisk::lba() const{
+    return this->registers[REG_LBA0] | (this->registers[REG_LBA1] << 8) | (this->registers[REG_LBA2] << 16)
+           | ((uint32_t)(this->registers[REG_LBA3] & 0x0f) << 24);
+}
+
+void IdeDisk::setLba(uint32_t lba){
+    this->registers[REG_LBA0] = lba & 0xff;
+    this->registers[REG_LBA1] = (lba >> 8) & 0xff;
+    this->registers[REG_LBA2] = (lba >> 16) & 0xff;
+    this->registers[REG_LBA3] = (this->registers[REG_LBA3] & 0xf0) | ((lba >> 24) & 0x0f);
+}
+
+uint8_t IdeDisk::ioRead(Cpu*, uint16_t port){
+    uint8_t reg = (uint8_t)(port - this->base) & 0x07;
+    switch (reg){
+        case REG_DATA: {
+            if (this->buffer == nullptr || this->writing){
+                return 0xff;
+            }
+            uint8_t data = this->buffer[this->position];
+            this->advance(1);
+            return data;
+        }
+        case REG_ERROR:
+            return this->error;
+        case REG_STATUS:
+            return this->status;
+        default:
+            return this->registers[reg];
+    }
+}
+
+void IdeDisk::ioWrite(Cpu*, uint16_t port, uint8_t data){
+    uint8_t reg = (uint8_t)(port - this->base) & 0x07;
+    switch (reg){
+        case REG_DATA:
+            if (this->buffer != nullptr && this->writing){
+                this->buffer[this->position] = data;
+                this->advance(1);
+            }
+            break;
+        case REG_STATUS:
+            this->command(data);
+            break;
+        default:
+            // REG_ERROR is the features register when written
+            this->registers[reg] = data;
+            break;
+    }
+}
+
+size_t IdeDisk::readBlock(Cpu*, uint16_t port, uint8_t* data, size_t count){
+    if (((uint8_t)(port - this->base) & 0x07) != REG_DATA || this->buffer == nullptr || this->writing){
+        return 0;
+    }
+    // The sectors of one command are consecutive in the image
+    size_t available = this->remaining * SECTOR_SIZE - this->position;
+    size_t size = (count < available) ? count : available;
+    memcpy(data, this->buffer + this->position, size);
+    this->advance(size);
+    return size;
+}
+
+size_t IdeDisk::writeBlock(Cpu*, uint16_t port, const uint8_t* data, size_t count){
+    if (((uint8_t)(port - this->base) & 0x07) != REG_DATA || this->buffer == nullptr || ! this->writing){
+        return 0;
+    }
+    size_t available = this->remaining * SECTOR_SIZE - this->position;
+    size_t size = (count < available) ? count : available;
+    memcpy(this->buffer + this->position, data, size);
+    this->advance(size);
+    return size;
+}
+
+void IdeDisk::advance(size_t count){
+    this->position += count;
+    size_t done = this->position / SECTOR_SIZE;
+    if (done == 0){
+        return;
+    }
+    this->position %= SECTOR_SIZE;
+    this->remaining -= done;
+    if (this->buffer != this->identify.data()){
+        // The task file follows the transfer, as after a multi-sector command
+        this->setLba(this->lba() + (uint32_t)done);
+        this->registers[REG_COUNT] = (uint8_t)this->remaining;
+    }
+    this->buffer += done * SECTOR_SIZE;
+    if (this->remaining == 0){
+        this->buffer = nullptr;
+        this->position = 0;
+        this->status &= ~STATUS_DRQ;
+    }
+}
+
+void IdeDisk::fail(uint8_t _error){
+    this->error = _error;
+    this->status = STATUS_RDY | STATUS_DSC | STATUS_ERR;
+    this->buffer = nullptr;
+    this->remaining = 0;
+}
+
+bool IdeDisk::startTransfer(bool write){
+    size_t count = (this->registers[REG_COUNT] == 0) ? 256 : this->registers[REG_COUNT];
+    size_t lba = this->lba();
+    if (lba + count > this->sector_count){
+        this->fail(ERROR_IDNF);
+        return false;
+    }
+    this->buffer = this->image + lba * SECTOR_SIZE;
+    this->position = 0;
+    this->remaining = count;
+    this->writing = write;
+    this->status = STATUS_RDY | STATUS_DSC | STATUS_DRQ;
+    return true;
+}
+
+void IdeDisk::command(uint8_t _command){
+    // Commands complete at once, so BSY is never seen
+    this->error = 0;
+    this->status = STATUS_RDY | STATUS_DSC;
+    switch (_command){
+        case COMMAND_READ:
+        case COMMAND_READ_NO_RETRY:
+            this->startTransfer(false);
+            break;
+        case COMMAND_WRITE:
+        case COMMAND_WRITE_NO_RETRY:
+            this->startTransfer(true);
+            break;
+        case COMMAND_IDENTIFY:
+            this->buffer = this->identify.data();
+            this->position = 0;
+            this->remaining = 1;
+            this->writing = false;
+            this->status |= STATUS_DRQ;
+            break;
+        case COMMAND_SET_FEATURES:
+            // 8-bit transfers are the only mode there is
+            break;
+        default:
+            this->fail(ERROR_ABRT);
+            break;
+    }
+}
+
+void IdeDisk::buildIdentify(){
+    auto word = [this](int index, uint16_t value){
+        this->identify[index * 2] = value & 0xff;
+        this->identify[index * 2 + 1] = value >> 8;
+    };
+    auto text = [this](int index, int words, const char* value){
+        // ATA strings: space padded, two characters per word with the first in the high byte
+        size_t length = strlen(value);
+        for (int i = 0; i < words * 2; i++){
+            char chr = (i < (int)length) ? value[i] : ' ';
+            this->identify[index * 2 + (i ^ 1)] = chr;
+        }
+    };
+    // CompactFlash signature
+    word(0, 0x848a);
+    // CHS geometry is only reported; addressing is LBA
+    word(1, (uint16_t)(this->sector_count / (16 * 63) > 0xffff ? 0xffff : this->sector_count / (16 * 63)));
+    word(3, 16);
+    word(6, 63);
+    text(10, 10, "Z80EMU0001");
+    text(23, 4, "1.0");
+    text(27, 20, "z80emu disk image");
+    // LBA supported
+    word(49, 0x0200);
+    word(60, (uint16_t)(this->sector_count & 0xffff));
+    word(61, (uint16_t)(this->sector_count >> 16));
+}
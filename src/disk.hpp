@@ -0,0 +1,93 @@
+#ifndef Z80EMU_DISK_HPP
+#define Z80EMU_DISK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "io.hpp"
+
+class Cpu;
+
+// CompactFlash card in 8-bit IDE mode, as on most homebrew CP/M boards, over a host disk image.
+//
+// The image is memory mapped and the sector buffer is a pointer into the mapping, so reading
+// and writing sectors makes no syscalls; the kernel writes dirty pages back. INIR/OTIR on the
+// data port move whole runs of sectors with one memcpy through readBlock/writeBlock.
+// Only LBA addressing is supported.
+class IdeDisk : public IoDevice {
+public:
+    static const size_t SECTOR_SIZE = 512;
+
+    // Register offsets from the base port
+    static const uint8_t REG_DATA = 0;
+    static const uint8_t REG_ERROR = 1;
+    static const uint8_t REG_COUNT = 2;
+    static const uint8_t REG_LBA0 = 3;
+    static const uint8_t REG_LBA1 = 4;
+    static const uint8_t REG_LBA2 = 5;
+    static const uint8_t REG_LBA3 = 6;
+    static const uint8_t REG_STATUS = 7;
+
+    // Status bits
+    static const uint8_t STATUS_ERR = 0x01;
+    static const uint8_t STATUS_DRQ = 0x08;
+    static const uint8_t STATUS_DSC = 0x10;
+    static const uint8_t STATUS_RDY = 0x40;
+    static const uint8_t STATUS_BSY = 0x80;
+    // Error bits
+    static const uint8_t ERROR_ABRT = 0x04;
+    static const uint8_t ERROR_IDNF = 0x10;
+
+    // Commands
+    static const uint8_t COMMAND_READ = 0x20;
+    static const uint8_t COMMAND_READ_NO_RETRY = 0x21;
+    static const uint8_t COMMAND_WRITE = 0x30;
+    static const uint8_t COMMAND_WRITE_NO_RETRY = 0x31;
+    static const uint8_t COMMAND_IDENTIFY = 0xec;
+    static const uint8_t COMMAND_SET_FEATURES = 0xef;
+
+    explicit IdeDisk(const char* path);
+    ~IdeDisk() override;
+    IdeDisk(const IdeDisk&) = delete;
+    IdeDisk& operator=(const IdeDisk&) = delete;
+
+    // Claims the eight task file registers from base
+    void attach(IoMap* map, uint8_t base);
+    void flush();
+
+    size_t sectors() const{ return this->sector_count; }
+
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+    size_t readBlock(Cpu* cpu, uint16_t port, uint8_t* data, size_t count) override;
+    size_t writeBlock(Cpu* cpu, uint16_t port, const uint8_t* data, size_t count) override;
+
+private:
+    uint8_t* image = nullptr;
+    size_t image_size = 0;
+    size_t sector_count = 0;
+    uint8_t base = 0;
+
+    uint8_t registers[8] = {};
+    uint8_t status = STATUS_RDY | STATUS_DSC;
+    uint8_t error = 0;
+
+    // Data phase: buffer[position..] belongs to the current sector, remaining counts it
+    uint8_t* buffer = nullptr;
+    size_t position = 0;
+    size_t remaining = 0;
+    bool writing = false;
+    std::array<uint8_t, SECTOR_SIZE> identify{};
+
+    uint32_t lba() const;
+    void setLba(uint32_t lba);
+    void command(uint8_t command);
+    void fail(uint8_t error);
+    bool startTransfer(bool write);
+    // Moves the data phase by count bytes, which stay within the sectors left
+    void advance(size_t count);
+    void buildIdentify();
+};
+
+#endif //Z80EMU_DISK_HPP
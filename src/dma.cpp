@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cstring>
+#include "dma.hpp"
+#include "cpu.hpp"
+#include "mcycle.hpp"
+
+Dma::Dma(){
+    this->reset();
+}
+
+void Dma::attach(Cpu* cpu, uint8_t port){
+    cpu->io_map.attach(port, this);
+}
+
+void Dma::reset(){
+    this->enabled = false;
+    this->auto_restart = false;
+    this->stop_on_match = false;
+    this->port_a.timing = 0;
+    this->port_b.timing = 0;
+    this->follow_count = 0;
+    this->follow_index = 0;
+    this->read_mask = 0x7f;
+    this->initiateRead();
+}
+
+void Dma::expect(uint8_t* parameter){
+    this->follow[this->follow_count++] = parameter;
+}
+
+void Dma::ioWrite(Cpu* cpu, uint16_t, uint8_t data){
+    if (this->follow_index < this->follow_count){
+        uint8_t* parameter = this->follow[this->follow_index++];
+        *parameter = data;
+        if (parameter == &this->interrupt_control){
+            // The interrupt control byte announces bytes of its own
+            if (data & 0x08){ this->expect(&this->pulse); }
+            if (data & 0x10){ this->expect(&this->vector); }
+        }
+        if (this->follow_index == this->follow_count && this->follow[0] == &this->read_mask){
+            this->initiateRead();
+        }
+        return;
+    }
+    this->follow_count = 0;
+    this->follow_index = 0;
+    this->writeRegister(cpu, data);
+}
+
+void Dma::writeRegister(Cpu* cpu, uint8_t data){
+    if ((data & 0x80) == 0){
+        if ((data & 0x03) != 0){
+            // WR0: direction, type, port A address and block length
+            this->type = data & 0x03;
+            this->a_to_b = (data & 0x04) != 0;
+            if (data & 0x08){ this->expect(&this->port_a.start[0]); }
+            if (data & 0x10){ this->expect(&this->port_a.start[1]); }
+            if (data & 0x20){ this->expect(&this->length[0]); }
+            if (data & 0x40){ this->expect(&this->length[1]); }
+        } else if (data & 0x04){
+            // WR1: port A
+            this->setPort(&this->port_a, data);
+        } else {
+            // WR2: port B
+            this->setPort(&this->port_b, data);
+        }
+        return;
+    }
+    switch (data & 0x03){
+        case 0x00:
+            // WR3: match, interrupt and DMA enable
+            this->stop_on_match = (data & 0x04) != 0;
+            if (data & 0x08){ this->expect(&this->mask); }
+            if (data & 0x10){ this->expect(&this->match); }
+            if (data & 0x40){
+                this->enabled = true;
+                this->request(cpu);
+            }
+            break;
+        case 0x01:
+            // WR4: mode, port B address, interrupt control
+            this->mode = (data >> 5) & 0x03;
+            if (data & 0x04){ this->expect(&this->port_b.start[0]); }
+            if (data & 0x08){ this->expect(&this->port_b.start[1]); }
+            if (data & 0x10){ this->expect(&this->interrupt_control); }
+            break;
+        case 0x02:
+            // WR5: ready, CE/WAIT and auto restart
+            this->auto_restart = (data & 0x20) != 0;
+            break;
+        default:
+            this->command(cpu, data);
+            break;
+    }
+}
+
+void Dma::setPort(Port* port, uint8_t data){
+    port->io = (data & 0x08) != 0;
+    switch ((data >> 4) & 0x03){
+        case 0x00: port->step = -1; break;
+        case 0x01: port->step = 1; break;
+        default: port->step = 0; break;
+    }
+    if (data & 0x40){
+        this->expect(&port->timing);
+    }
+}
+
+void Dma::command(Cpu* cpu, uint8_t command){
+    switch (command){
+        case COMMAND_RESET:
+            this->reset();
+            break;
+        case COMMAND_RESET_TIMING_A:
+            this->port_a.timing = 0;
+            break;
+        case COMMAND_RESET_TIMING_B:
+            this->port_b.timing = 0;
+            break;
+        case COMMAND_LOAD:
+            this->load();
+            break;
+        case COMMAND_CONTINUE:
+            // Same addresses, a new block
+            this->byte_counter = 0;
+            this->end_of_block = false;
+            break;
+        case COMMAND_REINITIALIZE_STATUS:
+            this->transferred = false;
+            this->match_found = false;
+            this->end_of_block = false;
+            break;
+        case COMMAND_READ_STATUS:
+            this->read_sequence[0] = 0;
+            this->read_count = 1;
+            this->read_index = 0;
+            break;
+        case COMMAND_INITIATE_READ:
+            this->initiateRead();
+            break;
+        case COMMAND_READ_MASK:
+            this->expect(&this->read_mask);
+            break;
+        case COMMAND_ENABLE:
+            this->enabled = true;
+            this->request(cpu);
+            break;
+        case COMMAND_DISABLE:
+            this->enabled = false;
+            break;
+        default:
+            // Interrupt control and force ready: nothing to do without interrupts and RDY
+            break;
+    }
+}
+
+void Dma::load(){
+    // Address counters start again from the programmed addresses
+    this->port_a.address = (uint16_t)(this->port_a.start[0] | (this->port_a.start[1] << 8));
+    this->port_b.address = (uint16_t)(this->port_b.start[0] | (this->port_b.start[1] << 8));
+    this->byte_counter = 0;
+    this->end_of_block = false;
+    this->match_found = false;
+}
+
+void Dma::request(Cpu* cpu){
+    if (! this->requested){
+        this->requested = true;
+        cpu->busRequest(this);
+    }
+}
+
+void Dma::initiateRead(){
+    this->read_count = 0;
+    for (uint8_t i = 0; i < 7; i++){
+        if (this->read_mask & (1 << i)){
+            this->read_sequence[this->read_count++] = i;
+        }
+    }
+    this->read_index = 0;
+}
+
+uint8_t Dma::status() const{
+    uint8_t value = STATUS_READY | STATUS_NO_INTERRUPT;
+    if (this->transferred){ value |= STATUS_TRANSFERRED; }
+    if (! this->match_found){ value |= STATUS_NO_MATCH; }
+    if (! this->end_of_block){ value |= STATUS_NOT_END; }
+    return value;
+}
+
+uint8_t Dma::ioRead(Cpu*, uint16_t){
+    if (this->read_count == 0){
+        return 0xff;
+    }
+    uint8_t reg = this->read_sequence[this->read_index];
+    this->read_index = (this->read_index + 1) % this->read_count;
+    switch (reg){
+        case 0: return this->status();
+        case 1: return (uint8_t)this->byte_counter;
+        case 2: return (uint8_t)(this->byte_counter >> 8);
+        case 3: return (uint8_t)this->port_a.address;
+        case 4: return (uint8_t)(this->port_a.address >> 8);
+        case 5: return (uint8_t)this->port_b.address;
+        default: return (uint8_t)(this->port_b.address >> 8);
+    }
+}
+
+uint32_t Dma::total() const{
+    // As on the Zilog part, one byte more than the block length
+    return (uint32_t)(this->length[0] | (this->length[1] << 8)) + 1;
+}
+
+void Dma::busGranted(Cpu* cpu){
+    this->requested = false;
+    if (! this->enabled || this->end_of_block){
+        return;
+    }
+    uint32_t limit = (this->mode == MODE_BYTE) ? 1 : this->total() - this->byte_counter;
+    while (limit > 0 && ! this->end_of_block && this->enabled){
+        uint32_t moved = this->transferBlock(cpu, limit);
+        if (moved == 0){
+            this->transferByte(cpu);
+            moved = 1;
+        }
+        limit -= moved;
+    }
+    if (this->end_of_block){
+        if (this->auto_restart){
+            this->load();
+            this->request(cpu);
+        } else {
+            this->enabled = false;
+        }
+    } else if (this->enabled){
+        // Byte mode: the CPU gets the bus back until the next request is seen
+        this->request(cpu);
+    }
+}
+
+void Dma::advance(uint32_t count){
+    Port& src = this->source();
+    Port& dst = this->destination();
+    src.address = (uint16_t)(src.address + src.step * (int)count);
+    dst.address = (uint16_t)(dst.address + dst.step * (int)count);
+    this->byte_counter += count;
+    this->transferred = true;
+    if (this->byte_counter >= this->total()){
+        this->end_of_block = true;
+    }
+}
+
+void Dma::transferByte(Cpu* cpu){
+    Port& src = this->source();
+    Port& dst = this->destination();
+    uint8_t data = src.io ? Mcycle::in(cpu, src.address & 0xff, src.address >> 8) : Mcycle::m2(cpu, src.address);
+    if (this->type & TYPE_TRANSFER){
+        if (dst.io){
+            Mcycle::out(cpu, dst.address & 0xff, dst.address >> 8, data);
+        } else {
+            Mcycle::m3(cpu, dst.address, data);
+        }
+    }
+    this->advance(1);
+    // Mask bits that are set are not compared
+    if ((this->type & TYPE_SEARCH) && (data | this->mask) == (this->match | this->mask)){
+        this->match_found = true;
+        if (this->stop_on_match){
+            this->enabled = false;
+        }
+    }
+}
+
+static void markDirty(Cpu* cpu, uint16_t addr, size_t count){
+    for (uint32_t page = addr >> 8; page <= (uint32_t)(addr + count - 1) >> 8; page++){
+        cpu->dirty_pages[page >> 6] |= (uint64_t)1 << (page & 0x3f);
+    }
+}
+
+uint32_t Dma::transferBlock(Cpu* cpu, uint32_t limit){
+    // Host memory only, and nobody watching single accesses
+    if (! cpu->enable_virtual_memory || cpu->debug_active || cpu->log_sink != nullptr || this->type != TYPE_TRANSFER){
+        return 0;
+    }
+    Port& src = this->source();
+    Port& dst = this->destination();
+    // Pieces end at host page boundaries, where the page table may point elsewhere
+    auto room = [](uint16_t addr){ return (uint32_t)Cpu::PAGE_MASK + 1 - (addr & Cpu::PAGE_MASK); };
+    // Memory mapped devices on the bus take single accesses
+    if ((! src.io && cpu->onBus(src.address, std::min(limit, room(src.address))))
+            || (! dst.io && cpu->onBus(dst.address, std::min(limit, room(dst.address))))){
+        return 0;
+    }
+    size_t count = limit;
+    if (! src.io && src.step == 1 && ! dst.io && dst.step == 1){
+        count = std::min<size_t>(count, std::min(room(src.address), room(dst.address)));
+        // A destination just ahead of the source repeats the bytes, as copying one at a time does
+        auto distance = (uint16_t)(dst.address - src.address);
+        if (distance != 0 && distance < count){
+            count = distance;
+        }
+        memmove(&cpu->memory(dst.address), &cpu->memory(src.address), count);
+    } else if (src.io && src.step == 0 && ! dst.io && dst.step == 1){
+        IoDevice* device = cpu->io_map.find(src.address);
+        if (device == nullptr){
+            return 0;
+        }
+        count = device->readBlock(cpu, src.address, &cpu->memory(dst.address), std::min<size_t>(count, room(dst.address)));
+    } else if (! src.io && src.step == 1 && dst.io && dst.step == 0){
+        IoDevice* device = cpu->io_map.find(dst.address);
+        if (device == nullptr){
+            return 0;
+        }
+        count = device->writeBlock(cpu, dst.address, &cpu->memory(src.address), std::min<size_t>(count, room(src.address)));
+    } else {
+        return 0;
+    }
+    if (count == 0){
+        return 0;
+    }
+    if (! dst.io){
+        cpu->idle_loop.written();
+        markDirty(cpu, dst.address, count);
+    }
+    cpu->tick += (src.cycles() + dst.cycles()) * count;
+    cpu->metrics.mcycles[src.io ? Metrics::MCYCLE_IO_READ : Metrics::MCYCLE_MEM_READ] += count;
+    cpu->metrics.mcycles[dst.io ? Metrics::MCYCLE_IO_WRITE : Metrics::MCYCLE_MEM_WRITE] += count;
+    this->advance((uint32_t)count);
+    return (uint32_t)count;
+}
@@ -0,0 +1,126 @@
+#ifndef Z80EMU_DMA_HPP
+#define Z80EMU_DMA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "io.hpp"
+
+class Cpu;
+
+// Z80 DMA: one channel between two ports, each memory or I/O, programmed through a single port.
+//
+// Once enabled it asks for the bus and moves the block while the CPU has it released. Byte
+// mode gives the bus back after every byte; continuous and burst modes keep it to the end of
+// the block, since emulated ports are always ready. Runs that are plain memory copies, or
+// that feed a device with block support, are copied in page sized pieces instead of byte by
+// byte, with the same T-states. Registers and commands follow the Zilog Z80 DMA technical
+// manual; interrupts and the timing bytes are accepted but not emulated.
+class Dma : public IoDevice, public BusMaster {
+public:
+    // Transfer types of WR0
+    static const uint8_t TYPE_TRANSFER = 0x01;
+    static const uint8_t TYPE_SEARCH = 0x02;
+
+    // Modes of WR4
+    static const uint8_t MODE_BYTE = 0;
+    static const uint8_t MODE_CONTINUOUS = 1;
+    static const uint8_t MODE_BURST = 2;
+
+    // WR6 commands
+    static const uint8_t COMMAND_RESET = 0xc3;
+    static const uint8_t COMMAND_RESET_TIMING_A = 0xc7;
+    static const uint8_t COMMAND_RESET_TIMING_B = 0xcb;
+    static const uint8_t COMMAND_LOAD = 0xcf;
+    static const uint8_t COMMAND_CONTINUE = 0xd3;
+    static const uint8_t COMMAND_DISABLE_INTERRUPTS = 0xaf;
+    static const uint8_t COMMAND_ENABLE_INTERRUPTS = 0xab;
+    static const uint8_t COMMAND_RESET_DISABLE_INTERRUPTS = 0xa3;
+    static const uint8_t COMMAND_ENABLE_AFTER_RETI = 0xb7;
+    static const uint8_t COMMAND_READ_STATUS = 0xbf;
+    static const uint8_t COMMAND_REINITIALIZE_STATUS = 0x8b;
+    static const uint8_t COMMAND_INITIATE_READ = 0xa7;
+    static const uint8_t COMMAND_FORCE_READY = 0xb3;
+    static const uint8_t COMMAND_ENABLE = 0x87;
+    static const uint8_t COMMAND_DISABLE = 0x83;
+    static const uint8_t COMMAND_READ_MASK = 0xbb;
+
+    // Status byte. Match and end of block are active low.
+    static const uint8_t STATUS_TRANSFERRED = 0x01;
+    static const uint8_t STATUS_READY = 0x02;
+    static const uint8_t STATUS_NO_INTERRUPT = 0x08;
+    static const uint8_t STATUS_NO_MATCH = 0x10;
+    static const uint8_t STATUS_NOT_END = 0x20;
+
+    Dma();
+    Dma(const Dma&) = delete;
+    Dma& operator=(const Dma&) = delete;
+
+    void attach(Cpu* cpu, uint8_t port);
+    void reset();
+
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+    void busGranted(Cpu* cpu) override;
+
+private:
+    struct Port {
+        uint8_t start[2] = {};
+        uint16_t address = 0;
+        bool io = false;
+        // +1, -1 or 0 for a fixed address
+        int step = 1;
+        uint8_t timing = 0;
+        // T-states of one access
+        uint64_t cycles() const{ return this->io ? 4 : 3; }
+    };
+
+    Port port_a;
+    Port port_b;
+    uint8_t length[2] = {};
+    uint8_t type = TYPE_TRANSFER;
+    bool a_to_b = true;
+    uint8_t mode = MODE_BURST;
+    bool stop_on_match = false;
+    bool auto_restart = false;
+    uint8_t mask = 0;
+    uint8_t match = 0;
+    uint8_t interrupt_control = 0;
+    uint8_t pulse = 0;
+    uint8_t vector = 0;
+
+    bool enabled = false;
+    bool requested = false;
+    bool transferred = false;
+    bool match_found = false;
+    bool end_of_block = false;
+    uint32_t byte_counter = 0;
+
+    // Parameter bytes the last register write announced
+    uint8_t* follow[8] = {};
+    int follow_count = 0;
+    int follow_index = 0;
+    uint8_t read_mask = 0x7f;
+    // Registers selected by the read mask, in read order
+    uint8_t read_sequence[7] = {};
+    int read_count = 0;
+    int read_index = 0;
+
+    void expect(uint8_t* parameter);
+    void writeRegister(Cpu* cpu, uint8_t data);
+    void command(Cpu* cpu, uint8_t command);
+    void setPort(Port* port, uint8_t data);
+    void load();
+    void request(Cpu* cpu);
+    void initiateRead();
+    uint8_t status() const;
+    uint32_t total() const;
+    Port& source(){ return this->a_to_b ? this->port_a : this->port_b; }
+    Port& destination(){ return this->a_to_b ? this->port_b : this->port_a; }
+
+    void transferByte(Cpu* cpu);
+    // Copies up to limit bytes in one piece where host memory allows. Returns 0 when it cannot.
+    uint32_t transferBlock(Cpu* cpu, uint32_t limit);
+    void advance(uint32_t count);
+};
+
+#endif //Z80EMU_DMA_HPP
@@ -0,0 +1,174 @@
+#include <stdexcept>
+#include <thread>
+#include "farm.hpp"
+#include "cpm.hpp"
+#include "cpu.hpp"
+#include "snapshot.hpp"
+#include "bus/simulated_bus.hpp"
+
+const char* FarmJob::stateName(uint8_t state){
+    switch (state){
+        case PENDING:           return "pending";
+        case FINISHED:          return "finished";
+        case HALTED:            return "halted";
+        case BUDGET_EXHAUSTED:  return "budget";
+        case FAILED:            return "failed";
+        default:                return "unknown";
+    }
+}
+
+struct Farm::Machine {
+    SimulatedBus bus;
+    Cpu cpu{&bus};
+};
+
+Farm::Farm(unsigned int _threads, uint64_t _slice){
+    this->threads = (_threads > 0) ? _threads : std::thread::hardware_concurrency();
+    if (this->threads == 0){
+        this->threads = 1;
+    }
+    this->slice = _slice;
+    for (unsigned int i = 0; i < this->threads; i++){
+        this->workers.emplace_back(new Worker());
+    }
+}
+
+void Farm::run(std::vector<FarmJob>& jobs){
+    for (size_t i = 0; i < jobs.size(); i++){
+        this->workers[i % this->threads]->queue.push_back({&jobs[i], nullptr});
+    }
+    this->remaining = jobs.size();
+
+    std::vector<std::thread> pool;
+    for (unsigned int id = 0; id < this->threads; id++){
+        pool.emplace_back(&Farm::work, this, id);
+    }
+    for (auto& thread : pool){
+        thread.join();
+    }
+}
+
+void Farm::work(unsigned int id){
+    while (this->remaining > 0){
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(this->idle_mutex);
+            seen = this->requeues;
+        }
+        Task task;
+        if (! this->pop(id, task) && ! this->steal(id, task)){
+            // Every job is running on another worker
+            std::unique_lock<std::mutex> lock(this->idle_mutex);
+            this->idle_wakeup.wait(lock, [this, seen](){
+                return this->requeues != seen || this->remaining == 0;
+            });
+            continue;
+        }
+        if (this->runSlice(task)){
+            if (--this->remaining == 0){
+                std::lock_guard<std::mutex> lock(this->idle_mutex);
+                this->idle_wakeup.notify_all();
+            }
+        } else {
+            this->push(id, std::move(task));
+        }
+    }
+}
+
+bool Farm::pop(unsigned int id, Task& task){
+    // The owner takes from the back
+    Worker* worker = this->workers[id].get();
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (worker->queue.empty()){
+        return false;
+    }
+    task = std::move(worker->queue.back());
+    worker->queue.pop_back();
+    return true;
+}
+
+bool Farm::steal(unsigned int id, Task& task){
+    // Thieves take from the front
+    for (unsigned int i = 1; i < this->threads; i++){
+        Worker* victim = this->workers[(id + i) % this->threads].get();
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (! victim->queue.empty()){
+            task = std::move(victim->queue.front());
+            victim->queue.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Farm::push(unsigned int id, Task task){
+    // Suspended jobs go to the front, behind everything the owner has not started yet
+    Worker* worker = this->workers[id].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->queue.push_front(std::move(task));
+    }
+    std::lock_guard<std::mutex> lock(this->idle_mutex);
+    this->requeues++;
+    this->idle_wakeup.notify_one();
+}
+
+// Returns true when the job is done.
+bool Farm::runSlice(Task& task) const {
+    FarmJob* job = task.job;
+    try {
+        if (task.machine == nullptr){
+            task.machine = std::make_shared<Machine>();
+            // Nothing drives the pins of the simulated bus
+            task.machine->cpu.setPinPolling(0);
+            task.machine->cpu.setIdleDetection(this->idle_detection);
+            task.machine->cpu.console_output = [job](uint8_t chr){
+                job->output += (char)chr;
+            };
+            if (Snapshot::isSnapshot(job->image_path.c_str())){
+                // Every job started from the same snapshot gets its own copy of the machine
+                task.machine->cpu.loadSnapshot(job->image_path.c_str());
+            } else {
+                Cpm::load(&task.machine->cpu, Cpm::readImage(job->image_path.c_str()), job->input.c_str());
+            }
+        }
+
+        Cpu* cpu = &task.machine->cpu;
+        uint64_t deadline = cpu->tick + this->slice;
+        if (job->budget > 0 && deadline > job->budget){
+            deadline = job->budget;
+        }
+        // Ends a skipped HALT at the end of the slice
+        cpu->scheduler.post(deadline, [](uint64_t){});
+        while (! cpu->stopped && cpu->tick < deadline){
+            cpu->step();
+            if (cpu->halt && ! cpu->iff1){
+                // Nothing can wake it up on the simulated bus
+                break;
+            }
+        }
+        job->tstates = cpu->tick;
+        job->instructions = cpu->metrics.instructions;
+
+        if (cpu->stopped){
+            job->state = FarmJob::FINISHED;
+        } else if (cpu->halt && ! cpu->iff1){
+            job->state = FarmJob::HALTED;
+        } else if (job->budget > 0 && cpu->tick >= job->budget){
+            job->state = FarmJob::BUDGET_EXHAUSTED;
+        } else {
+            return false;
+        }
+    } catch (std::exception& e){
+        // Also std::bad_alloc and the like, which would otherwise end the whole farm
+        job->state = FarmJob::FAILED;
+        job->error = e.what();
+        if (task.machine != nullptr){
+            job->tstates = task.machine->cpu.tick;
+            job->instructions = task.machine->cpu.metrics.instructions;
+        }
+    }
+    // Release the machine as soon as the job is done
+    task.machine.reset();
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef Z80EMU_FARM_HPP
+#define Z80EMU_FARM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Cpu;
+class SimulatedBus;
+
+// A CP/M program to run headless, and what came out of it.
+struct FarmJob {
+    static const uint8_t PENDING = 0;
+    static const uint8_t FINISHED = 1;
+    static const uint8_t HALTED = 2;
+    static const uint8_t BUDGET_EXHAUSTED = 3;
+    static const uint8_t FAILED = 4;
+
+    std::string image_path;
+    std::string input;
+    uint64_t budget = 0;
+
+    uint8_t state = PENDING;
+    std::string output;
+    std::string error;
+    uint64_t tstates = 0;
+    uint64_t instructions = 0;
+
+    static const char* stateName(uint8_t state);
+};
+
+// Runs jobs on a work-stealing thread pool, one Cpu per job.
+// Each job runs for at most `slice` T-states at a time and is then requeued, so long jobs
+// do not starve short ones and idle workers can steal suspended machines.
+class Farm {
+public:
+    static const uint64_t DEFAULT_SLICE = 1000 * 1000;
+
+    explicit Farm(unsigned int threads = 0, uint64_t slice = DEFAULT_SLICE);
+
+    void run(std::vector<FarmJob>& jobs);
+
+    // Skips polling loops in every job, like z80cpm --idle
+    bool idle_detection = false;
+
+private:
+    struct Machine;
+    struct Task {
+        FarmJob* job;
+        std::shared_ptr<Machine> machine;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queue;
+    };
+
+    unsigned int threads;
+    uint64_t slice;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> remaining{0};
+    // Workers with nothing to run or steal sleep here until a task is requeued or all are done
+    std::mutex idle_mutex;
+    std::condition_variable idle_wakeup;
+    // Bumped under idle_mutex on every requeue
+    uint64_t requeues = 0;
+
+    void work(unsigned int id);
+    bool pop(unsigned int id, Task& task);
+    bool steal(unsigned int id, Task& task);
+    void push(unsigned int id, Task task);
+    bool runSlice(Task& task) const;
+};
+
+#endif //Z80EMU_FARM_HPP
@@ -0,0 +1,446 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "gdbstub.hpp"
+#include "cpu.hpp"
+#include "mcycle.hpp"
+#include "reverse.hpp"
+
+static const char HEX[] = "0123456789abcdef";
+
+static void appendHex8(std::string& out, uint8_t value){
+    out += HEX[value >> 4];
+    out += HEX[value & 0x0f];
+}
+
+static void appendHex16(std::string& out, uint16_t value){
+    // Target byte order
+    appendHex8(out, value & 0xff);
+    appendHex8(out, value >> 8);
+}
+
+static int hexDigit(char c){
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static uint8_t parseHex8(const char* p){
+    return (uint8_t)(hexDigit(p[0]) << 4 | hexDigit(p[1]));
+}
+
+static uint16_t parseHex16(const char* p){
+    return parseHex8(p) | parseHex8(p + 2) << 8;
+}
+
+GdbStub::GdbStub(Cpu* _cpu, ReverseExecution* _reverse) : cpu(_cpu), reverse(_reverse) {}
+
+GdbStub::~GdbStub(){
+    if (this->fd >= 0){
+        close(this->fd);
+    }
+    if (this->listen_fd >= 0){
+        close(this->listen_fd);
+    }
+    if (! this->unix_path.empty()){
+        unlink(this->unix_path.c_str());
+    }
+}
+
+void GdbStub::listen(const char* address){
+    const char* port = (*address == ':') ? address + 1 : address;
+    bool tcp = (*port != '\0' && strspn(port, "0123456789") == strlen(port));
+
+    if (tcp){
+        this->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(this->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(port));
+        // Local only: the protocol has no authentication
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (this->listen_fd < 0 || bind(this->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+            throw std::runtime_error("Cannot bind gdb port");
+        }
+    } else {
+        this->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)){
+            throw std::runtime_error("gdb socket path too long");
+        }
+        strcpy(addr.sun_path, address);
+        unlink(address);
+        if (this->listen_fd < 0 || bind(this->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+            throw std::runtime_error("Cannot bind gdb socket");
+        }
+        this->unix_path = address;
+    }
+    if (::listen(this->listen_fd, 1) < 0){
+        throw std::runtime_error("Cannot listen for gdb");
+    }
+    fprintf(stderr, "Waiting for gdb on %s\n", address);
+    this->fd = accept(this->listen_fd, nullptr, nullptr);
+    if (this->fd < 0){
+        throw std::runtime_error("Cannot accept gdb connection");
+    }
+    if (tcp){
+        int on = 1;
+        setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    this->attached = true;
+}
+
+void GdbStub::run(){
+    bool debug_active = this->cpu->debug_active;
+    this->cpu->debug_active = true;
+    this->cpu->debug.attached = true;
+    std::string packet;
+    while (this->attached && this->readPacket(packet)){
+        std::string reply = this->handle(packet);
+        if (packet[0] == 'k'){
+            break;
+        }
+        this->sendPacket(reply);
+        if (packet == "QStartNoAckMode"){
+            this->no_ack = true;
+        }
+        if (reply[0] == 'W'){
+            // The program has ended
+            break;
+        }
+    }
+    // Watchpoints set up by the program itself stay armed
+    this->cpu->debug_active = debug_active;
+    this->cpu->debug.attached = false;
+    this->cpu->debug.updateActive();
+}
+
+int GdbStub::readChar(){
+    if (this->received.empty()){
+        char buffer[4096];
+        ssize_t size = recv(this->fd, buffer, sizeof(buffer), 0);
+        if (size <= 0){
+            return -1;
+        }
+        this->received.assign(buffer, size);
+    }
+    int c = (uint8_t)this->received[0];
+    this->received.erase(0, 1);
+    return c;
+}
+
+bool GdbStub::readPacket(std::string& packet){
+    while (true){
+        int c = this->readChar();
+        if (c < 0){
+            return false;
+        }
+        if (c != '$'){
+            // Acks, and interrupts that arrive while already stopped
+            continue;
+        }
+        packet.clear();
+        uint8_t sum = 0;
+        while ((c = this->readChar()) >= 0 && c != '#'){
+            packet += (char)c;
+            sum += (uint8_t)c;
+        }
+        int high = this->readChar();
+        int low = this->readChar();
+        if (c < 0 || high < 0 || low < 0){
+            return false;
+        }
+        if (this->no_ack){
+            return true;
+        }
+        if ((hexDigit((char)high) << 4 | hexDigit((char)low)) == sum){
+            send(this->fd, "+", 1, 0);
+            return true;
+        }
+        send(this->fd, "-", 1, 0);
+    }
+}
+
+void GdbStub::sendPacket(const std::string& data){
+    uint8_t sum = 0;
+    for (char c : data){
+        sum += (uint8_t)c;
+    }
+    std::string frame = "$" + data + "#";
+    appendHex8(frame, sum);
+    send(this->fd, frame.data(), frame.size(), 0);
+}
+
+bool GdbStub::interrupted(){
+    if (this->received.empty()){
+        struct pollfd pfd{this->fd, POLLIN, 0};
+        if (poll(&pfd, 1, 0) <= 0){
+            return false;
+        }
+    }
+    int c = this->readChar();
+    return c == 0x03 || c < 0;
+}
+
+std::string GdbStub::handle(const std::string& packet){
+    const char* p = packet.c_str();
+    switch (p[0]){
+        case '?':
+            return "S05";
+        case 'g': {
+            std::string reply;
+            for (int n = 0; n < REGISTER_COUNT; n++){
+                appendHex16(reply, this->readRegister(n));
+            }
+            return reply;
+        }
+        case 'G':
+            if (packet.size() < 1 + REGISTER_COUNT * 4){
+                return "E01";
+            }
+            for (int n = 0; n < REGISTER_COUNT; n++){
+                this->writeRegister(n, parseHex16(p + 1 + n * 4));
+            }
+            this->changed();
+            return "OK";
+        case 'p': {
+            int n = (int)strtol(p + 1, nullptr, 16);
+            if (n >= REGISTER_COUNT){
+                return "E01";
+            }
+            std::string reply;
+            appendHex16(reply, this->readRegister(n));
+            return reply;
+        }
+        case 'P': {
+            char* end;
+            int n = (int)strtol(p + 1, &end, 16);
+            if (n >= REGISTER_COUNT || *end != '=' || strlen(end + 1) < 4){
+                return "E01";
+            }
+            this->writeRegister(n, parseHex16(end + 1));
+            this->changed();
+            return "OK";
+        }
+        case 'm': {
+            char* end;
+            uint16_t addr = (uint16_t)strtoul(p + 1, &end, 16);
+            size_t length = strtoul(end + 1, nullptr, 16);
+            std::string reply;
+            for (size_t i = 0; i < length && i < 0x10000; i++){
+                appendHex8(reply, this->readByte(addr + i));
+            }
+            return reply;
+        }
+        case 'M': {
+            char* end;
+            uint16_t addr = (uint16_t)strtoul(p + 1, &end, 16);
+            size_t length = strtoul(end + 1, &end, 16);
+            if (*end != ':' || strlen(end + 1) < length * 2){
+                return "E01";
+            }
+            for (size_t i = 0; i < length; i++){
+                this->writeByte(addr + i, parseHex8(end + 1 + i * 2));
+            }
+            this->changed();
+            return "OK";
+        }
+        case 'c':
+        case 's':
+            if (p[1] != '\0'){
+                this->cpu->special_registers.pc = (uint16_t)strtoul(p + 1, nullptr, 16);
+                this->changed();
+            }
+            return this->resume(p[0] == 's');
+        case 'b':
+            if (this->reverse != nullptr && (p[1] == 's' || p[1] == 'c')){
+                return this->reverseResume(p[1] == 's');
+            }
+            return "";
+        case 'Z':
+        case 'z': {
+            char* end;
+            int type = (int)strtol(p + 1, &end, 10);
+            uint16_t addr = (uint16_t)strtoul(end + 1, &end, 16);
+            uint16_t length = (uint16_t)strtoul(end + 1, nullptr, 16);
+            bool insert = (p[0] == 'Z');
+            if (type == 0 || type == 1){
+                this->cpu->debug.setBreakpoint(addr, insert);
+                return "OK";
+            }
+            if (type >= 2 && type <= 4){
+                static const uint8_t types[] = {Debug::WATCH_WRITE, Debug::WATCH_READ, Debug::WATCH_ACCESS};
+                if (insert){
+                    this->cpu->debug.addWatchpoint(addr, length, types[type - 2]);
+                } else {
+                    this->cpu->debug.removeWatchpoint(addr, length, types[type - 2]);
+                }
+                return "OK";
+            }
+            return "";
+        }
+        case 'D':
+            this->attached = false;
+            return "OK";
+        case 'k':
+            this->cpu->stopped = true;
+            this->attached = false;
+            return "";
+        case 'H':
+        case 'T':
+            return "OK";
+        case 'q':
+            if (packet.rfind("qSupported", 0) == 0){
+                std::string reply = "PacketSize=1000";
+                if (this->reverse != nullptr){
+                    reply += ";ReverseStep+;ReverseContinue+";
+                }
+                return reply;
+            }
+            if (packet == "qAttached"){
+                return "1";
+            }
+            if (packet == "qC"){
+                return "QC1";
+            }
+            if (packet == "qfThreadInfo"){
+                return "m1";
+            }
+            if (packet == "qsThreadInfo"){
+                return "l";
+            }
+            return "";
+        case 'Q':
+            return (packet == "QStartNoAckMode") ? "OK" : "";
+        default:
+            return "";
+    }
+}
+
+std::string GdbStub::resume(bool single_step){
+    this->cpu->debug.resume(single_step);
+    uint32_t count = 0;
+    while (! this->cpu->stopped){
+        if (this->reverse != nullptr){
+            this->reverse->step();
+        } else {
+            this->cpu->step();
+        }
+        if (this->cpu->debug.stop_reason != Debug::STOP_NONE){
+            return this->stopReply();
+        }
+        if ((++count & 0xfff) == 0 && this->interrupted()){
+            return "T02";
+        }
+    }
+    return "W00";
+}
+
+std::string GdbStub::reverseResume(bool single_step){
+    bool moved;
+    if (single_step){
+        moved = this->reverse->reverseStep();
+    } else {
+        moved = this->reverse->reverseContinue([](Cpu* c){
+            return c->debug.isBreakpoint(c->special_registers.pc);
+        });
+        if (! moved){
+            this->reverse->seek(this->reverse->start());
+        }
+    }
+    return moved ? "T05" : "T05replaylog:begin;";
+}
+
+std::string GdbStub::stopReply(){
+    if (this->cpu->debug.stop_reason != Debug::STOP_WATCH){
+        return "T05";
+    }
+    std::string reply = "T05";
+    switch (this->cpu->debug.watch_type){
+        case Debug::WATCH_WRITE: reply += "watch:";  break;
+        case Debug::WATCH_READ:  reply += "rwatch:"; break;
+        default:                 reply += "awatch:"; break;
+    }
+    char addr[8];
+    snprintf(addr, sizeof(addr), "%x;", this->cpu->debug.watch_addr);
+    return reply + addr;
+}
+
+uint16_t GdbStub::readRegister(int n){
+    switch (n){
+        case 0:  return this->cpu->registers.af();
+        case 1:  return this->cpu->registers.bc();
+        case 2:  return this->cpu->registers.de();
+        case 3:  return this->cpu->registers.hl();
+        case 4:  return this->cpu->special_registers.sp;
+        case 5:  return this->cpu->special_registers.pc;
+        case 6:  return this->cpu->special_registers.ix;
+        case 7:  return this->cpu->special_registers.iy;
+        case 8:  return this->cpu->registers_alternate.af();
+        case 9:  return this->cpu->registers_alternate.bc();
+        case 10: return this->cpu->registers_alternate.de();
+        case 11: return this->cpu->registers_alternate.hl();
+        default: return this->cpu->special_registers.i << 8 | this->cpu->special_registers.r;
+    }
+}
+
+void GdbStub::writeRegister(int n, uint16_t value){
+    switch (n){
+        case 0:  this->cpu->registers.af(value); break;
+        case 1:  this->cpu->registers.bc(value); break;
+        case 2:  this->cpu->registers.de(value); break;
+        case 3:  this->cpu->registers.hl(value); break;
+        case 4:  this->cpu->special_registers.sp = value; break;
+        case 5:  this->cpu->special_registers.pc = value; break;
+        case 6:  this->cpu->special_registers.ix = value; break;
+        case 7:  this->cpu->special_registers.iy = value; break;
+        case 8:  this->cpu->registers_alternate.af(value); break;
+        case 9:  this->cpu->registers_alternate.bc(value); break;
+        case 10: this->cpu->registers_alternate.de(value); break;
+        case 11: this->cpu->registers_alternate.hl(value); break;
+        default:
+            this->cpu->special_registers.i = value >> 8;
+            this->cpu->special_registers.r = value & 0xff;
+            break;
+    }
+}
+
+uint8_t GdbStub::readByte(uint16_t addr){
+    if (this->cpu->enable_virtual_memory){
+        return this->cpu->memory(addr);
+    }
+    // Real memory cycle. Not an access of the program, so watchpoints stay quiet.
+    this->cpu->debug_active = false;
+    uint8_t data = Mcycle::m2(this->cpu, addr);
+    this->cpu->debug_active = true;
+    return data;
+}
+
+void GdbStub::writeByte(uint16_t addr, uint8_t data){
+    if (this->cpu->enable_virtual_memory){
+        this->cpu->memory(addr) = data;
+        this->cpu->dirty_pages[addr >> 14] |= (uint64_t)1 << ((addr >> 8) & 0x3f);
+        return;
+    }
+    this->cpu->debug_active = false;
+    Mcycle::m3(this->cpu, addr, data);
+    this->cpu->debug_active = true;
+}
+
+void GdbStub::changed(){
+    // Recorded history no longer leads to this state
+    if (this->reverse != nullptr){
+        this->reverse->invalidate();
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef Z80EMU_GDBSTUB_HPP
+#define Z80EMU_GDBSTUB_HPP
+
+#include <cstdint>
+#include <string>
+
+class Cpu;
+class ReverseExecution;
+
+// GDB remote serial protocol server for one Cpu.
+// Registers follow GDB's z80 target: af bc de hl sp pc ix iy af' bc' de' hl' ir, 16 bits each.
+// With a ReverseExecution, reverse-step and reverse-continue are offered as well.
+class GdbStub {
+public:
+    static const int REGISTER_COUNT = 13;
+
+    explicit GdbStub(Cpu* cpu, ReverseExecution* reverse = nullptr);
+    ~GdbStub();
+    GdbStub(const GdbStub&) = delete;
+    GdbStub& operator=(const GdbStub&) = delete;
+
+    // "1234" or ":1234" listens on TCP localhost, anything else is a Unix socket path.
+    // Returns once a debugger has connected.
+    void listen(const char* address);
+    // Runs the machine under control of the debugger until it detaches or the program ends
+    void run();
+
+private:
+    Cpu* cpu;
+    ReverseExecution* reverse;
+    int listen_fd = -1;
+    int fd = -1;
+    std::string unix_path;
+    std::string received;
+    bool no_ack = false;
+    bool attached = false;
+
+    int readChar();
+    bool readPacket(std::string& packet);
+    void sendPacket(const std::string& data);
+    bool interrupted();
+
+    std::string handle(const std::string& packet);
+    std::string resume(bool single_step);
+    std::string reverseResume(bool single_step);
+    std::string stopReply();
+
+    uint16_t readRegister(int n);
+    void writeRegister(int n, uint16_t value);
+    uint8_t readByte(uint16_t addr);
+    void writeByte(uint16_t addr, uint8_t data);
+    void changed();
+};
+
+#endif //Z80EMU_GDBSTUB_HPP
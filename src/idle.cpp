@@ -0,0 +1,108 @@
+#include <ctime>
+#include "idle.hpp"
+#include "cpu.hpp"
+#include "console.hpp"
+
+IdleLoop::IdleLoop(Cpu* _cpu) : cpu(_cpu) {
+}
+
+void IdleLoop::reset(){
+    this->previous.valid = false;
+    this->idle_pass = false;
+    this->clocked = false;
+    this->read_hash = 0;
+}
+
+void IdleLoop::capture(uint16_t pc, Head* head){
+    Cpu* c = this->cpu;
+    head->valid = true;
+    head->registers = {
+            pc, c->registers.af(), c->registers.bc(), c->registers.de(), c->registers.hl(),
+            c->registers_alternate.af(), c->registers_alternate.bc(),
+            c->registers_alternate.de(), c->registers_alternate.hl(),
+            c->special_registers.ix, c->special_registers.iy, c->special_registers.sp,
+            (uint16_t)(c->special_registers.i | c->iff1 << 8 | c->iff2 << 9 | c->interrupt_mode << 10),
+    };
+    head->r = c->special_registers.r;
+    head->tick = c->tick;
+    head->instructions = c->metrics.instructions;
+    for (int i = 0; i < Metrics::MCYCLE_TYPES; i++){
+        head->mcycles[i] = c->metrics.mcycles[i];
+    }
+    head->memory_changes = this->memory_changes;
+    head->read_hash = this->read_hash;
+}
+
+void IdleLoop::head(uint16_t pc){
+    if (this->cpu->halt || this->cpu->waitingEI != 0 || this->cpu->waitingDI != 0){
+        this->reset();
+        return;
+    }
+    Cpu* c = this->cpu;
+    Quick quick;
+    quick.registers = {pc, c->registers.af(), c->registers.bc(), c->registers.de(), c->registers.hl()};
+    quick.memory_changes = this->memory_changes;
+    quick.io_writes = c->metrics.mcycles[Metrics::MCYCLE_IO_WRITE];
+    bool same = quick == this->quick;
+    this->quick = quick;
+    if (! same || this->clocked){
+        // Not idle, nor a pass to compare the next one with
+        this->reset();
+        return;
+    }
+    Head now;
+    this->capture(pc, &now);
+    this->read_hash = 0;
+    bool idle = this->previous.valid && now.registers == this->previous.registers
+                && now.memory_changes == this->previous.memory_changes
+                && now.mcycles[Metrics::MCYCLE_IO_WRITE] == this->previous.mcycles[Metrics::MCYCLE_IO_WRITE]
+                && ! this->clocked;
+    this->clocked = false;
+    if (idle && this->idle_pass && now.read_hash == this->previous.read_hash){
+        this->skip(now);
+        // Checked from scratch on the next passes
+        this->previous.valid = false;
+        this->idle_pass = false;
+        return;
+    }
+    this->idle_pass = idle;
+    this->previous = now;
+}
+
+void IdleLoop::skip(const Head& now){
+    Cpu* c = this->cpu;
+    uint64_t length = now.tick - this->previous.tick;
+    uint64_t deadline = c->scheduler.deadline();
+    if (deadline == Scheduler::NEVER){
+        // Only the host can change an input now
+        this->yields++;
+        struct timespec ts{0, (long)YIELD_NS};
+        nanosleep(&ts, nullptr);
+        if (c->console != nullptr){
+            c->console->pollSoon();
+        }
+        return;
+    }
+    if (length == 0 || deadline <= now.tick){
+        return;
+    }
+    // Whole passes only, so the event comes at the same instruction as without skipping
+    uint64_t passes = (deadline - now.tick) / length;
+    if (passes == 0){
+        return;
+    }
+    c->tick += passes * length;
+    uint8_t r1 = (c->special_registers.r & 0b10000000);
+    uint8_t r7 = (c->special_registers.r + passes * (uint8_t)(now.r - this->previous.r)) & 0b01111111;
+    c->special_registers.r = r1 | r7;
+    for (int i = 0; i < Metrics::MCYCLE_TYPES; i++){
+        c->metrics.mcycles[i] += passes * (now.mcycles[i] - this->previous.mcycles[i]);
+    }
+    uint64_t before = c->metrics.instructions;
+    c->metrics.instructions += passes * (now.instructions - this->previous.instructions);
+    if ((before >> 16) != (c->metrics.instructions >> 16) && c->metrics_publisher != nullptr){
+        c->metrics_publisher->publish(c->metrics, c->tick);
+    }
+    this->skipped_passes += passes;
+    c->pace();
+}
@@ -0,0 +1,94 @@
+#ifndef Z80EMU_IDLE_HPP
+#define Z80EMU_IDLE_HPP
+
+#include <array>
+#include <cstdint>
+#include "metrics.hpp"
+
+class Cpu;
+
+// Finds polling loops such as "in a,(n) / and m / jr z,$-4" or "jr $".
+//
+// A short backward jump is a loop head. A pass from one head to the next is idle when the
+// registers are back where they were, no memory changed, no port was written and no read
+// followed the T-state counter. Two idle passes in a row that read the same port values mean
+// the loop will spin until a device event or the host changes an input. Then the T-state
+// counter jumps over the whole passes up to the next scheduler event, or, with nothing
+// scheduled, the host thread sleeps a moment. Either way the next passes run normally and
+// are checked again, so the loop leaves as soon as it reads something new.
+//
+// Most short loops do work. Those are ruled out on pc, the main registers and the write
+// counters, so the whole state is only copied for passes that changed none of them.
+class IdleLoop {
+public:
+    // Bytes from the jump back to the head
+    static const uint16_t MAX_LOOP_SIZE = 32;
+    static const uint64_t YIELD_NS = 1000000;
+
+    explicit IdleLoop(Cpu* cpu);
+
+    // Before every instruction fetch while enabled
+    void check(uint16_t pc){
+        if (pc <= this->last_pc && this->last_pc - pc <= MAX_LOOP_SIZE){
+            this->head(pc);
+        }
+        this->last_pc = pc;
+    }
+    void read(uint16_t port, uint8_t data){
+        this->read_hash = (this->read_hash ^ ((uint32_t)port << 8 | data)) * 0x100000001b3ull;
+    }
+    // A write that changed memory
+    void written(){
+        this->memory_changes++;
+    }
+    // A port read whose value follows the T-state counter, like a running CTC down-counter
+    void clockedRead(){
+        this->clocked = true;
+    }
+    void reset();
+
+    // Passes skipped and host sleeps
+    uint64_t skipped_passes = 0;
+    uint64_t yields = 0;
+
+private:
+    struct Head {
+        bool valid = false;
+        std::array<uint16_t, 13> registers{};
+        uint8_t r = 0;
+        uint64_t tick = 0;
+        uint64_t instructions = 0;
+        uint64_t mcycles[Metrics::MCYCLE_TYPES] = {};
+        uint64_t memory_changes = 0;
+        // Reads of the pass that ended here
+        uint64_t read_hash = 0;
+    };
+
+    // What the previous head ruled loops out on
+    struct Quick {
+        std::array<uint16_t, 5> registers{};
+        uint64_t memory_changes = 0;
+        uint64_t io_writes = 0;
+
+        bool operator==(const Quick& other) const{
+            return this->registers == other.registers && this->memory_changes == other.memory_changes
+                   && this->io_writes == other.io_writes;
+        }
+    };
+
+    Cpu* cpu;
+    uint16_t last_pc = 0;
+    uint64_t read_hash = 0;
+    uint64_t memory_changes = 0;
+    bool clocked = false;
+    // The pass that ended at previous was idle
+    bool idle_pass = false;
+    Quick quick;
+    Head previous;
+
+    void head(uint16_t pc);
+    void capture(uint16_t pc, Head* head);
+    void skip(const Head& now);
+};
+
+#endif //Z80EMU_IDLE_HPP
@@ -0,0 +1,72 @@
+#include "io.hpp"
+
+IoMap::IoMap(bool full_decode){
+    this->mask = full_decode ? 0xffff : 0x00ff;
+    this->devices.assign((size_t)this->mask + 1, nullptr);
+}
+
+void IoMap::attach(uint16_t port, IoDevice* device, uint16_t ignore){
+    this->fill(port, device, ignore);
+}
+
+void IoMap::attach(uint16_t first, uint16_t count, IoDevice* device, uint16_t ignore){
+    for (uint32_t i = 0; i < count; i++){
+        this->fill((uint16_t)(first + i), device, ignore);
+    }
+}
+
+void IoMap::detach(uint16_t port, uint16_t ignore){
+    this->fill(port, nullptr, ignore);
+}
+
+void IoMap::fill(uint16_t port, IoDevice* device, uint16_t ignore){
+    // Every table index that matches port on the decoded bits
+    uint16_t fixed = port & ~ignore & this->mask;
+    uint16_t free = ignore & this->mask;
+    uint16_t index = 0;
+    do {
+        this->devices[fixed | index] = device;
+        index = (index - free) & free;
+    } while (index != 0);
+}
+
+bool IoMap::snapshotSafe() const{
+    for (IoDevice* device : this->devices){
+        if (device != nullptr && ! device->inSnapshot()){
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoMap::addInterruptSource(InterruptSource* source){
+    this->sources.push_back(source);
+}
+
+InterruptSource* IoMap::findInterrupt(uint64_t now){
+    for (InterruptSource* source : this->sources){
+        if (source->inService()){
+            return nullptr;
+        }
+        if (source->intPending(now)){
+            return source;
+        }
+    }
+    return nullptr;
+}
+
+uint8_t IoMap::interruptAcknowledge(InterruptSource* source, uint64_t now){
+    uint8_t vector = source->intAcknowledge(now);
+    this->updateInterrupt(now);
+    return vector;
+}
+
+void IoMap::interruptReturn(uint64_t now){
+    for (InterruptSource* source : this->sources){
+        if (source->inService()){
+            source->intReturn();
+            break;
+        }
+    }
+    this->updateInterrupt(now);
+}
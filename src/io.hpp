@@ -0,0 +1,102 @@
+#ifndef Z80EMU_IO_HPP
+#define Z80EMU_IO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Cpu;
+
+// Peripheral emulated in host code. Called from Mcycle::in/out instead of running a bus cycle.
+class IoDevice {
+public:
+    virtual ~IoDevice() = default;
+    virtual uint8_t ioRead(Cpu* cpu, uint16_t port) = 0;
+    virtual void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) = 0;
+
+    // INIR/INDR/OTIR/OTDR on a claimed port: the same as up to count ioRead/ioWrite calls on
+    // port, in one go. data is in transfer order whichever way HL runs. Returns how many bytes
+    // moved; the rest, if any, go through ioRead/ioWrite.
+    virtual size_t readBlock(Cpu*, uint16_t, uint8_t*, size_t){ return 0; }
+    virtual size_t writeBlock(Cpu*, uint16_t, const uint8_t*, size_t){ return 0; }
+
+    // Snapshots save and restore the device's state. Other devices, and their scheduler events,
+    // would carry on from where they are, so a restore would not be deterministic.
+    virtual bool inSnapshot() const{ return false; }
+};
+
+// Emulated device that drives INT. Sources form a daisy chain in the order they were added to
+// an IoMap, the first with the highest priority.
+class InterruptSource {
+public:
+    virtual ~InterruptSource() = default;
+    // Wants to interrupt. Not asked while a higher priority source is in service.
+    virtual bool intPending(uint64_t now) = 0;
+    // Interrupt acknowledge: returns the vector and goes in service
+    virtual uint8_t intAcknowledge(uint64_t now) = 0;
+    virtual bool inService() = 0;
+    // RETI seen on the bus
+    virtual void intReturn() = 0;
+};
+
+// Emulated device that takes the bus from the CPU, such as a DMA controller.
+// It asks with Cpu::busRequest and runs when the CPU has released the bus.
+class BusMaster {
+public:
+    virtual ~BusMaster() = default;
+    // BUSACK is low. Moves data and advances cpu->tick by the T-states it holds the bus for.
+    virtual void busGranted(Cpu* cpu) = 0;
+};
+
+// Port to device table, looked up once per IN/OUT.
+// Only the low byte of the port selects a device by default, like most Z80 boards. With
+// full_decode the table has an entry for every 16-bit port. Ports without a device go to the bus.
+class IoMap {
+public:
+    explicit IoMap(bool full_decode = false);
+
+    // Claims port. Address bits set in ignore are not decoded, so the device answers whatever
+    // they are. The default matches low-byte decoding in both table sizes.
+    void attach(uint16_t port, IoDevice* device, uint16_t ignore = 0xff00);
+    void attach(uint16_t first, uint16_t count, IoDevice* device, uint16_t ignore = 0xff00);
+    // Gives the port back to the bus
+    void detach(uint16_t port, uint16_t ignore = 0xff00);
+
+    IoDevice* find(uint16_t port) const{
+        return this->devices[port & this->mask];
+    }
+    bool fullDecode() const{ return this->mask == 0xffff; }
+    // No attached device has state that snapshots leave out
+    bool snapshotSafe() const;
+
+    // Appended at the low priority end of the daisy chain
+    void addInterruptSource(InterruptSource* source);
+    // Devices call this whenever their request may have changed: on register writes and from
+    // their scheduler events. Between calls the CPU only looks at the cached line.
+    void updateInterrupt(uint64_t now){
+        this->interrupt_line = this->findInterrupt(now) != nullptr;
+    }
+    // Source that interrupts now, or null. A source in service holds off itself and everything behind it.
+    InterruptSource* interruptRequest(uint64_t now){
+        if (! this->interrupt_line){
+            return nullptr;
+        }
+        return this->findInterrupt(now);
+    }
+    // Interrupt acknowledge for source, which interruptRequest returned
+    uint8_t interruptAcknowledge(InterruptSource* source, uint64_t now);
+    // RETI ends the service of the highest priority source in service
+    void interruptReturn(uint64_t now);
+
+private:
+    uint16_t mask;
+    std::vector<IoDevice*> devices;
+    std::vector<InterruptSource*> sources;
+    bool interrupt_line = false;
+
+    InterruptSource* findInterrupt(uint64_t now);
+
+    void fill(uint16_t port, IoDevice* device, uint16_t ignore);
+};
+
+#endif //Z80EMU_IO_HPP
@@ -1,21 +1,30 @@
 #include "log.hpp"
 #include "cpu.hpp"
 #include <string>
-#include <fstream>
 #include "config.hpp"
 
-void Log::write(char* string){
+bool Log::enabled(Cpu* cpu){
 #ifdef Z80EMU_ENABLE_LOG
-    static std::ofstream stream("log.txt");
-    char buffer[400];
-    snprintf(buffer, sizeof(buffer), "%s", string);
-
-    stream << buffer << std::endl;
-//    printf("%s\n", buffer);
+    return cpu->log_sink != nullptr;
+#else
+    return false;
 #endif //Z80EMU_ENABLE_LOG
 }
 
+void Log::write(Cpu* cpu, const char* string){
+    std::ostream* stream = cpu->log_sink;
+    *stream << string << std::endl;
+    if (stream->fail()){
+        cpu->metrics.trace_drops++;
+        stream->clear();
+    }
+//    printf("%s\n", string);
+}
+
 void Log::dump_registers(Cpu *cpu) {
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer),
              "type:registers\t\t\taf:%04x bc:%04x de:%04x hl:%04x i:%02x r:%02x ix:%04x iy:%04x sp:%04x pc:%04x / FC:%s FN:%s FP/V:%s FH:%s FZ:%s FS:%s",
@@ -36,59 +45,86 @@ void Log::dump_registers(Cpu *cpu) {
              cpu->registers.FZ_Zero ? "true" : "false",
              cpu->registers.FS_Sign ? "true" : "false"
              );
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::execute(Cpu* cpu, uint8_t op_code, const char* mnemonic){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:execute\tpc:%04x %02x: %s", cpu->special_registers.pc - 1, op_code, mnemonic);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::general(Cpu* cpu, const char* step){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:general\t\t\ttext:%s", step);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::target_register(Cpu* cpu, const char* reg_name){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:register\t\t\tregister:%s", reg_name);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::error(Cpu* cpu, const char* error){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:error\t\t\terror:%s", error);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::mem_read(Cpu* cpu, uint16_t addr, uint8_t data){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:m2(read)\t\t\taddr:%04x\tdata:%02x", addr, data);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::mem_write(Cpu* cpu, uint16_t addr, uint8_t data){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:m3(write)\t\t\taddr:%04x\tdata:%02x", addr, data);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::io_read(Cpu* cpu, uint16_t addr, uint8_t data){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:io(read)\t\t\taddr:%04x\tdata:%02x", addr, data);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::io_write(Cpu* cpu, uint16_t addr, uint8_t data){
+    if (! enabled(cpu)){
+        return;
+    }
     char buffer[400];
     snprintf(buffer, sizeof(buffer), "type:io(write)\t\t\taddr:%04x\tdata:%02x", addr, data);
-    write(buffer);
+    write(cpu, buffer);
 }
 
 void Log::bus(Bus* bus, const char* step){
-    char buffer[400];
-    snprintf(buffer, sizeof(buffer), "type:bus\t\t\ttext:%s", step);
-    write(buffer);
+#ifdef Z80EMU_ENABLE_LOG
+    if (bus->log_sink == nullptr){
+        return;
+    }
+    *bus->log_sink << "type:bus\t\t\ttext:" << step << std::endl;
+#endif //Z80EMU_ENABLE_LOG
 }
@@ -2,6 +2,7 @@
 #define Z80EMU_LOG_HPP
 
 #include <cstdint>
+#include <ostream>
 #include "bus/bus.hpp"
 
 class Cpu;
@@ -9,7 +10,8 @@ class Mcycle;
 
 class Log {
 public:
-    static void write(char* string);
+    static bool enabled(Cpu* cpu);
+    static void write(Cpu* cpu, const char* string);
     static void dump_registers(Cpu *cpu);
     static void execute(Cpu* cpu, uint8_t op_code, const char* mnemonic);
     static void general(Cpu* cpu, const char* step);
@@ -4,9 +4,14 @@
 #include "cpu.hpp"
 #include "log.hpp"
 #include "bus/pigpio_bus_bulk.hpp"
+#include "bus/bus_worker.hpp"
 #include <unistd.h>
 
 void Mcycle::int_m1t1t2t3(Cpu *cpu){
+    cpu->metrics.mcycles[Metrics::MCYCLE_INT_ACK]++;
+    // T1, T2, 2 automatic wait states and T3. T4 follows in m1t4.
+    cpu->tick += 5;
+    cpu->syncBus();
     // t1
     cpu->bus->waitClockRising();
     cpu->bus->setAddress(cpu->special_registers.pc);
@@ -28,6 +33,8 @@ void Mcycle::int_m1t1t2t3(Cpu *cpu){
     cpu->bus->waitClockFalling();
     while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
         cpu->bus->waitClockFalling();
+        cpu->tick++;
+        cpu->metrics.wait_cycles++;
     }
     // T3-rising: Fetch data. Output refresh address. Update control signals
     cpu->bus->waitClockRising();
@@ -48,12 +55,29 @@ void Mcycle::int_m1t1t2t3(Cpu *cpu){
     cpu->bus->syncControl();
 }
 
+void Mcycle::int_m1vm(Cpu *cpu, uint8_t vector){
+    // Acknowledge of an emulated device: no bus cycle, the device hands over the vector.
+    cpu->metrics.mcycles[Metrics::MCYCLE_INT_ACK]++;
+    cpu->tick += 6;
+    cpu->executing = vector;
+    uint8_t r1 = (cpu->special_registers.r & 0b10000000);
+    uint8_t r7 = ((cpu->special_registers.r + 1) & 0x7f);
+    cpu->special_registers.r = r1 | r7;
+}
+
 void Mcycle::m1vm(Cpu *cpu){
-    cpu->executing = cpu->virtual_memory[cpu->special_registers.pc];
+    cpu->metrics.mcycles[Metrics::MCYCLE_M1]++;
+    cpu->tick += 4;
+    cpu->executing = cpu->memory(cpu->special_registers.pc);
     cpu->special_registers.pc++;
 }
 
 void Mcycle::m1halt(Cpu *cpu){
+    cpu->metrics.mcycles[Metrics::MCYCLE_HALT]++;
+    cpu->metrics.halted_tstates += 4;
+    // T1 - T3. T4 is counted by m1t4.
+    cpu->tick += 3;
+    cpu->syncBus();
     // T1
     cpu->bus->waitClockRising();
     cpu->bus->waitClockFalling();
@@ -81,6 +105,9 @@ void Mcycle::m1halt(Cpu *cpu){
 
 void Mcycle::m1t1(Cpu *cpu){
     // T1: Output PC's address
+    cpu->metrics.mcycles[Metrics::MCYCLE_M1]++;
+    cpu->tick++;
+    cpu->syncBus();
     cpu->bus->syncControl();
 
     cpu->bus->waitClockRising();
@@ -96,15 +123,19 @@ void Mcycle::m1t1(Cpu *cpu){
 
 void Mcycle::m1t2(Cpu* cpu){
     // T2: Wait memory until WAIT is inactive
+    cpu->tick++;
     cpu->bus->waitClockRising();
     cpu->bus->waitClockFalling();
     while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
         cpu->bus->waitClockFalling();
+        cpu->tick++;
+        cpu->metrics.wait_cycles++;
     }
 }
 
 void Mcycle::m1t3(Cpu* cpu) {
     // T3-rising: Fetch data. Output refresh address. Update control signals
+    cpu->tick++;
     cpu->bus->waitClockRising();
     cpu->executing = cpu->bus->getData();
 
@@ -125,6 +156,7 @@ void Mcycle::m1t3(Cpu* cpu) {
 
 void Mcycle::m1t4(Cpu* cpu) {
     // T4: Inactivate MREQ, RFSH. Increment R resistor.
+    cpu->tick++;
     cpu->bus->waitClockRising();
     cpu->bus->waitClockFalling();
     cpu->bus->pin_o_mreq = Bus::PIN_HIGH;
@@ -133,100 +165,99 @@ void Mcycle::m1t4(Cpu* cpu) {
     cpu->bus->pin_o_rfsh = Bus::PIN_HIGH;
 
     uint8_t r1 = (cpu->special_registers.r & 0b10000000);
-    uint8_t r7 = (cpu->special_registers.r + 1 & 0b01111111);
+    uint8_t r7 = ((cpu->special_registers.r + 1) & 0x7f);
     cpu->special_registers.r = r1 | r7;
+    cpu->busRequestPoint();
 }
 
-uint8_t Mcycle::m2(Cpu* cpu, uint16_t addr){
-    if (cpu->enable_virtual_memory){
-        Log::mem_read(cpu, addr, cpu->virtual_memory[addr]);
-        return cpu->virtual_memory[addr];
+static void countWaits(Cpu* cpu, uint64_t waits){
+    cpu->tick += waits;
+    cpu->metrics.wait_cycles += waits;
+}
+
+// On the worker thread when there is one. Reads wait for the writes posted before them.
+static uint8_t busRead(Cpu* cpu, bool io, uint16_t addr){
+    uint8_t data;
+    if (cpu->bus_worker != nullptr){
+        countWaits(cpu, cpu->bus_worker->read(io, addr, &data));
+    } else {
+        countWaits(cpu, io ? Mcycle::ioReadCycle(cpu->bus, addr, &data) : Mcycle::memReadCycle(cpu->bus, addr, &data));
     }
+    return data;
+}
 
-    // T1
-    cpu->bus->waitClockRising();
-    cpu->bus->setAddress(addr);
-    cpu->bus->waitClockFalling();
-    cpu->bus->pin_o_mreq = Bus::PIN_LOW;
-    cpu->bus->pin_o_rd = Bus::PIN_LOW;
-    cpu->bus->syncControl();
-    // T2
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
-        cpu->bus->waitClockFalling();
+// Posted to the worker: its wait states are counted at the next read or Cpu::syncBus
+static void busWrite(Cpu* cpu, bool io, uint16_t addr, uint8_t data){
+    if (cpu->bus_worker != nullptr){
+        cpu->bus_worker->write(io, addr, data);
+    } else {
+        countWaits(cpu, io ? Mcycle::ioWriteCycle(cpu->bus, addr, data) : Mcycle::memWriteCycle(cpu->bus, addr, data));
+    }
+}
+
+uint8_t Mcycle::m2(Cpu* cpu, uint16_t addr){
+    cpu->metrics.mcycles[Metrics::MCYCLE_MEM_READ]++;
+    cpu->tick += 3;
+    if (cpu->enable_virtual_memory && ! cpu->onBus(addr)){
+        uint8_t data = cpu->memory(addr);
+        Log::mem_read(cpu, addr, data);
+        if (cpu->debug.isWatched(addr)){
+            cpu->debug.access(addr, Debug::WATCH_READ, data);
+        }
+        return data;
     }
-    // T3
-    cpu->bus->waitClockRising();
-    uint8_t data = cpu->bus->getData();
-    cpu->bus->waitClockFalling();
-    cpu->bus->pin_o_mreq = Bus::PIN_HIGH;
-    cpu->bus->pin_o_rd = Bus::PIN_HIGH;
-    cpu->bus->syncControl();
+
+    uint8_t data = busRead(cpu, false, addr);
+    cpu->busRequestPoint();
+    // A device register when host memory holds the rest
+    cpu->idle_loop.read(addr, data);
 
     Log::mem_read(cpu, addr, data);
+    if (cpu->debug.isWatched(addr)){
+        cpu->debug.access(addr, Debug::WATCH_READ, data);
+    }
 
     return data;
 }
 
 void Mcycle::m3(Cpu* cpu, uint16_t addr, uint8_t data){
-    if (cpu->enable_virtual_memory){
-        cpu->virtual_memory[addr] = data;
+    cpu->metrics.mcycles[Metrics::MCYCLE_MEM_WRITE]++;
+    cpu->tick += 3;
+    if (cpu->debug.isWatched(addr)){
+        cpu->debug.access(addr, Debug::WATCH_WRITE, data);
+    }
+    if (cpu->enable_virtual_memory && ! cpu->onBus(addr)){
+        uint8_t& cell = cpu->memory(addr);
+        if (cell != data){
+            cpu->idle_loop.written();
+            cell = data;
+        }
+        cpu->dirty_pages[addr >> 14] |= (uint64_t)1 << ((addr >> 8) & 0x3f);
         Log::mem_write(cpu, addr, data);
         return;
     }
 
-    // T1
-    cpu->bus->waitClockRising();
-    cpu->bus->setAddress(addr);
-    cpu->bus->waitClockFalling();
-    cpu->bus->setDataBegin(data);
-    cpu->bus->pin_o_mreq = Bus::PIN_LOW;
-    cpu->bus->syncControl();
-    // T2
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
-        cpu->bus->waitClockFalling();
-    }
-    cpu->bus->pin_o_wr = Bus::PIN_LOW;
-    cpu->bus->syncControl();
-    // T3
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    cpu->bus->pin_o_mreq = Bus::PIN_HIGH;
-    cpu->bus->pin_o_wr = Bus::PIN_HIGH;
-    cpu->bus->syncControl();
-    cpu->bus->setDataEnd();
+    busWrite(cpu, false, addr, data);
+    cpu->busRequestPoint();
+    cpu->idle_loop.written();
 
     Log::mem_write(cpu, addr, data);
 }
 
 uint8_t Mcycle::in(Cpu* cpu, uint8_t portL, uint8_t portH){
-    // T1
-    cpu->bus->waitClockRising();
+    cpu->metrics.mcycles[Metrics::MCYCLE_IO_READ]++;
+    cpu->tick += 4;
     uint16_t port = (portH << 8) | portL;
-    cpu->bus->setAddress(port);
-    cpu->bus->waitClockFalling();
-    // T2
-    cpu->bus->waitClockRising();
-    cpu->bus->pin_o_iorq = Bus::PIN_LOW;
-    cpu->bus->pin_o_rd = Bus::PIN_LOW;
-    cpu->bus->syncControl();
-    cpu->bus->waitClockFalling();
-    // TW
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
-        cpu->bus->waitClockFalling();
+    IoDevice* device = cpu->io_map.find(port);
+    if (device != nullptr){
+        uint8_t data = device->ioRead(cpu, port);
+        cpu->idle_loop.read(port, data);
+        Log::io_read(cpu, port, data);
+        return data;
     }
-    // T3
-    cpu->bus->waitClockRising();
-    uint8_t data = cpu->bus->getData();
-    cpu->bus->waitClockFalling();
-    cpu->bus->pin_o_iorq = Bus::PIN_HIGH;
-    cpu->bus->pin_o_rd = Bus::PIN_HIGH;
-    cpu->bus->syncControl();
+    uint8_t data = busRead(cpu, true, port);
+    cpu->busRequestPoint();
+    cpu->idle_loop.read(port, data);
 
     Log::io_read(cpu, port, data);
 
@@ -234,31 +265,130 @@ uint8_t Mcycle::in(Cpu* cpu, uint8_t portL, uint8_t portH){
 }
 
 void Mcycle::out(Cpu* cpu, uint8_t portL, uint8_t portH, uint8_t data){
-    // T1
-    cpu->bus->waitClockRising();
+    cpu->metrics.mcycles[Metrics::MCYCLE_IO_WRITE]++;
+    cpu->tick += 4;
     uint16_t port = (portH << 8) | portL;
-    cpu->bus->setAddress(port);
-    cpu->bus->setDataBegin(data);
-    cpu->bus->waitClockFalling();
+    IoDevice* device = cpu->io_map.find(port);
+    if (device != nullptr){
+        device->ioWrite(cpu, port, data);
+        Log::io_write(cpu, port, data);
+        return;
+    }
+    busWrite(cpu, true, port, data);
+    cpu->busRequestPoint();
+
+    Log::io_write(cpu, port, data);
+}
+
+uint64_t Mcycle::memReadCycle(Bus* bus, uint16_t addr, uint8_t* data){
+    uint64_t waits = 0;
+    // T1
+    bus->waitClockRising();
+    bus->setAddress(addr);
+    bus->waitClockFalling();
+    bus->pin_o_mreq = Bus::PIN_LOW;
+    bus->pin_o_rd = Bus::PIN_LOW;
+    bus->syncControl();
     // T2
-    cpu->bus->waitClockRising();
-    cpu->bus->pin_o_iorq = Bus::PIN_LOW;
-    cpu->bus->pin_o_wr = Bus::PIN_LOW;
-    cpu->bus->syncControl();
-    cpu->bus->waitClockFalling();
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    while (!bus->getInput(Bus::Z80_PIN_I_WAIT)){
+        bus->waitClockFalling();
+        waits++;
+    }
+    // T3
+    bus->waitClockRising();
+    *data = bus->getData();
+    bus->waitClockFalling();
+    bus->pin_o_mreq = Bus::PIN_HIGH;
+    bus->pin_o_rd = Bus::PIN_HIGH;
+    bus->syncControl();
+    return waits;
+}
+
+uint64_t Mcycle::memWriteCycle(Bus* bus, uint16_t addr, uint8_t data){
+    uint64_t waits = 0;
+    // T1
+    bus->waitClockRising();
+    bus->setAddress(addr);
+    bus->waitClockFalling();
+    bus->setDataBegin(data);
+    bus->pin_o_mreq = Bus::PIN_LOW;
+    bus->syncControl();
+    // T2
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    while (!bus->getInput(Bus::Z80_PIN_I_WAIT)){
+        bus->waitClockFalling();
+        waits++;
+    }
+    bus->pin_o_wr = Bus::PIN_LOW;
+    bus->syncControl();
+    // T3
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    bus->pin_o_mreq = Bus::PIN_HIGH;
+    bus->pin_o_wr = Bus::PIN_HIGH;
+    bus->syncControl();
+    bus->setDataEnd();
+    return waits;
+}
+
+uint64_t Mcycle::ioReadCycle(Bus* bus, uint16_t port, uint8_t* data){
+    uint64_t waits = 0;
+    // T1
+    bus->waitClockRising();
+    bus->setAddress(port);
+    bus->waitClockFalling();
+    // T2
+    bus->waitClockRising();
+    bus->pin_o_iorq = Bus::PIN_LOW;
+    bus->pin_o_rd = Bus::PIN_LOW;
+    bus->syncControl();
+    bus->waitClockFalling();
     // TW
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    while (!cpu->bus->getInput(Bus::Z80_PIN_I_WAIT)){
-        cpu->bus->waitClockFalling();
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    while (!bus->getInput(Bus::Z80_PIN_I_WAIT)){
+        bus->waitClockFalling();
+        waits++;
     }
     // T3
-    cpu->bus->waitClockRising();
-    cpu->bus->waitClockFalling();
-    cpu->bus->pin_o_iorq = Bus::PIN_HIGH;
-    cpu->bus->pin_o_wr = Bus::PIN_HIGH;
-    cpu->bus->syncControl();
-    cpu->bus->setDataEnd();
+    bus->waitClockRising();
+    *data = bus->getData();
+    bus->waitClockFalling();
+    bus->pin_o_iorq = Bus::PIN_HIGH;
+    bus->pin_o_rd = Bus::PIN_HIGH;
+    bus->syncControl();
+    return waits;
+}
 
-    Log::io_write(cpu, port, data);
+uint64_t Mcycle::ioWriteCycle(Bus* bus, uint16_t port, uint8_t data){
+    uint64_t waits = 0;
+    // T1
+    bus->waitClockRising();
+    bus->setAddress(port);
+    bus->setDataBegin(data);
+    bus->waitClockFalling();
+    // T2
+    bus->waitClockRising();
+    bus->pin_o_iorq = Bus::PIN_LOW;
+    bus->pin_o_wr = Bus::PIN_LOW;
+    bus->syncControl();
+    bus->waitClockFalling();
+    // TW
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    while (!bus->getInput(Bus::Z80_PIN_I_WAIT)){
+        bus->waitClockFalling();
+        waits++;
+    }
+    // T3
+    bus->waitClockRising();
+    bus->waitClockFalling();
+    bus->pin_o_iorq = Bus::PIN_HIGH;
+    bus->pin_o_wr = Bus::PIN_HIGH;
+    bus->syncControl();
+    bus->setDataEnd();
+    return waits;
 }
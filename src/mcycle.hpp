@@ -1,11 +1,15 @@
 #ifndef Z80EMU_MCYCLE_HPP
 #define Z80EMU_MCYCLE_HPP
 
+#include <cstdint>
+
+class Bus;
 class Cpu;
 
 class Mcycle {
 public:
     static void int_m1t1t2t3(Cpu* cpu);
+    static void int_m1vm(Cpu* cpu, uint8_t vector);
     static void m1vm(Cpu* cpu);
     static void m1halt(Cpu* cpu);
 
@@ -19,6 +23,13 @@ public:
 
     static uint8_t in(Cpu* cpu, uint8_t portL, uint8_t portH);
     static void out(Cpu* cpu, uint8_t portL, uint8_t portH, uint8_t data);
+
+    // Bus side of m2, m3, in and out: the pin sequence only. Return the wait states inserted.
+    // Run by the Cpu thread, or by the bus worker for transactions it was handed.
+    static uint64_t memReadCycle(Bus* bus, uint16_t addr, uint8_t* data);
+    static uint64_t memWriteCycle(Bus* bus, uint16_t addr, uint8_t data);
+    static uint64_t ioReadCycle(Bus* bus, uint16_t port, uint8_t* data);
+    static uint64_t ioWriteCycle(Bus* bus, uint16_t port, uint8_t data);
 };
 
 #endif //Z80EMU_MCYCLE_HPP
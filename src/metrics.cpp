@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "metrics.hpp"
+
+MetricsPublisher::MetricsPublisher(const char* _name){
+    snprintf(this->name, sizeof(this->name), "%s", _name);
+
+    int fd = shm_open(this->name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0){
+        throw std::runtime_error("shm_open failed (metrics)");
+    }
+    if (ftruncate(fd, sizeof(MetricsPage)) < 0){
+        close(fd);
+        throw std::runtime_error("ftruncate failed (metrics)");
+    }
+    void* addr = mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED){
+        throw std::runtime_error("mmap failed (metrics)");
+    }
+
+    this->page = static_cast<MetricsPage*>(addr);
+    this->page->sequence.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(&this->page->sample, 0, sizeof(this->page->sample));
+    this->page->magic = MetricsPage::MAGIC;
+    this->page->version = MetricsPage::VERSION;
+    this->page->pid = getpid();
+    this->page->sequence.store(2, std::memory_order_release);
+
+    this->last_ns = monotonic_ns();
+}
+
+MetricsPublisher::~MetricsPublisher(){
+    munmap(this->page, sizeof(MetricsPage));
+    shm_unlink(this->name);
+}
+
+void MetricsPublisher::publish(const Metrics& metrics, uint64_t tstates){
+    uint64_t now = monotonic_ns();
+    double elapsed = static_cast<double>(now - this->last_ns) / 1e9;
+
+    uint32_t seq = this->page->sequence.load(std::memory_order_relaxed);
+    this->page->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    MetricsSample* sample = &this->page->sample;
+    sample->timestamp_ns = now;
+    if (elapsed > 0){
+        sample->instructions_per_sec = static_cast<double>(metrics.instructions - this->last_instructions) / elapsed;
+        sample->tstates_per_sec = static_cast<double>(tstates - this->last_tstates) / elapsed;
+    }
+    sample->instructions = metrics.instructions;
+    sample->tstates = tstates;
+    memcpy(sample->mcycles, metrics.mcycles, sizeof(sample->mcycles));
+    sample->wait_cycles = metrics.wait_cycles;
+    sample->nmi_taken = metrics.nmi_taken;
+    sample->int_taken = metrics.int_taken;
+    sample->halted_tstates = metrics.halted_tstates;
+    sample->bus_releases = metrics.bus_releases;
+    sample->busack_tstates = metrics.busack_tstates;
+    sample->trace_drops = metrics.trace_drops;
+
+    this->page->sequence.store(seq + 2, std::memory_order_release);
+
+    this->last_ns = now;
+    this->last_instructions = metrics.instructions;
+    this->last_tstates = tstates;
+}
+
+const MetricsPage* MetricsPublisher::attach(const char* name){
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0){
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED){
+        return nullptr;
+    }
+    auto page = static_cast<const MetricsPage*>(addr);
+    if (page->magic != MetricsPage::MAGIC || page->version != MetricsPage::VERSION){
+        munmap(addr, sizeof(MetricsPage));
+        return nullptr;
+    }
+    return page;
+}
+
+void MetricsPublisher::detach(const MetricsPage* page){
+    munmap(const_cast<MetricsPage*>(page), sizeof(MetricsPage));
+}
+
+bool MetricsPublisher::read(const MetricsPage* page, MetricsSample* sample){
+    for (int retry = 0; retry < 1000; retry++){
+        uint32_t before = page->sequence.load(std::memory_order_acquire);
+        if (before & 1){
+            continue;
+        }
+        memcpy(sample, &page->sample, sizeof(MetricsSample));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = page->sequence.load(std::memory_order_relaxed);
+        if (before == after){
+            return true;
+        }
+    }
+    return false;
+}
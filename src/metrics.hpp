@@ -0,0 +1,94 @@
+#ifndef Z80EMU_METRICS_HPP
+#define Z80EMU_METRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+// Served by the vDSO, so this does not enter the kernel.
+inline uint64_t monotonic_ns(){
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Counters owned by a single Cpu. Only the CPU thread writes them, so they are plain integers.
+class Metrics {
+public:
+    static const uint8_t MCYCLE_M1 = 0;
+    static const uint8_t MCYCLE_MEM_READ = 1;
+    static const uint8_t MCYCLE_MEM_WRITE = 2;
+    static const uint8_t MCYCLE_IO_READ = 3;
+    static const uint8_t MCYCLE_IO_WRITE = 4;
+    static const uint8_t MCYCLE_INT_ACK = 5;
+    static const uint8_t MCYCLE_HALT = 6;
+    static const uint8_t MCYCLE_TYPES = 7;
+
+    uint64_t instructions = 0;
+    uint64_t mcycles[MCYCLE_TYPES] = {};
+    // T-states added by WAIT
+    uint64_t wait_cycles = 0;
+    uint64_t nmi_taken = 0;
+    uint64_t int_taken = 0;
+    uint64_t halted_tstates = 0;
+    // BUSACK cycles and the T-states another master held the bus for
+    uint64_t bus_releases = 0;
+    uint64_t busack_tstates = 0;
+    // Trace entries the log sink could not write
+    uint64_t trace_drops = 0;
+};
+
+// Plain copy of the published values.
+struct MetricsSample {
+    uint64_t timestamp_ns;
+    double instructions_per_sec;
+    double tstates_per_sec;
+    uint64_t instructions;
+    uint64_t tstates;
+    uint64_t mcycles[Metrics::MCYCLE_TYPES];
+    uint64_t wait_cycles;
+    uint64_t nmi_taken;
+    uint64_t int_taken;
+    uint64_t halted_tstates;
+    uint64_t bus_releases;
+    uint64_t busack_tstates;
+    uint64_t trace_drops;
+};
+
+// Layout of the shared memory segment.
+// sequence is odd while the writer updates sample; readers retry until they see the same even value twice.
+struct MetricsPage {
+    static const uint32_t MAGIC = 0x5a383054; // "Z80T"
+    static const uint32_t VERSION = 2;
+
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    uint32_t pid;
+    MetricsSample sample;
+};
+
+class MetricsPublisher {
+public:
+    static constexpr const char* DEFAULT_NAME = "/z80emu";
+
+    explicit MetricsPublisher(const char* name = DEFAULT_NAME);
+    ~MetricsPublisher();
+    MetricsPublisher(const MetricsPublisher&) = delete;
+    MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+
+    void publish(const Metrics& metrics, uint64_t tstates);
+
+    static const MetricsPage* attach(const char* name);
+    static void detach(const MetricsPage* page);
+    static bool read(const MetricsPage* page, MetricsSample* sample);
+
+private:
+    MetricsPage* page;
+    char name[64];
+    uint64_t last_ns = 0;
+    uint64_t last_instructions = 0;
+    uint64_t last_tstates = 0;
+};
+
+#endif //Z80EMU_METRICS_HPP
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "mmu.hpp"
+#include "cpu.hpp"
+
+// 256-byte pages, the unit of the Cpu dirty bitmap
+static const size_t DIRTY_SHIFT = 8;
+static const size_t DIRTY_SIZE = (size_t)1 << DIRTY_SHIFT;
+
+Mmu::Mmu(size_t store_size, size_t _page_size) : page_size(_page_size){
+    size_t host_page = (size_t)Cpu::PAGE_MASK + 1;
+    if (this->page_size < host_page || this->page_size > 0x10000 || (this->page_size & (this->page_size - 1)) != 0){
+        throw std::runtime_error("MMU page size must be a power of two from 4KB to 64KB");
+    }
+    this->window_count = 0x10000 / this->page_size;
+    this->page_count = store_size / this->page_size;
+    // Window registers are 8 bits wide
+    if (this->page_count < this->window_count || this->page_count > 256){
+        throw std::runtime_error("MMU store must hold 64KB to 256 pages");
+    }
+    this->store.assign(this->page_count * this->page_size, 0);
+    this->registers.assign(this->window_count, 0);
+    this->dirty.assign((this->store.size() / DIRTY_SIZE + 63) / 64, 0);
+}
+
+void Mmu::attach(Cpu* _cpu, uint8_t _base){
+    this->cpu = _cpu;
+    this->base = _base;
+    memcpy(this->store.data(), _cpu->virtual_memory.data(), _cpu->virtual_memory.size());
+    _cpu->mmu = this;
+    for (size_t window = 0; window < this->window_count; window++){
+        this->registers[window] = (uint8_t)window;
+        this->install(window);
+    }
+    _cpu->io_map.attach(_base, (uint16_t)this->window_count, this);
+}
+
+void Mmu::map(size_t window, size_t page){
+    this->collectDirty(window);
+    this->registers[window] = (uint8_t)page;
+    this->install(window);
+}
+
+void Mmu::install(size_t window){
+    size_t page = this->registers[window] % this->page_count;
+    size_t host_pages = this->page_size >> Cpu::PAGE_SHIFT;
+    uint8_t* host = this->store.data() + page * this->page_size;
+    for (size_t i = 0; i < host_pages; i++){
+        this->cpu->page_table[window * host_pages + i] = host + (i << Cpu::PAGE_SHIFT);
+    }
+}
+
+void Mmu::collectDirty(size_t window){
+    size_t count = this->page_size >> DIRTY_SHIFT;
+    size_t from = window * count;
+    size_t to = (this->registers[window] % this->page_count) * count;
+    for (size_t i = 0; i < count; i++){
+        uint64_t& word = this->cpu->dirty_pages[(from + i) >> 6];
+        uint64_t bit = (uint64_t)1 << ((from + i) & 0x3f);
+        if (word & bit){
+            this->dirty[(to + i) >> 6] |= (uint64_t)1 << ((to + i) & 0x3f);
+            word &= ~bit;
+        }
+    }
+}
+
+uint8_t Mmu::ioRead(Cpu*, uint16_t port){
+    return this->registers[(uint8_t)(port - this->base) % this->window_count];
+}
+
+void Mmu::ioWrite(Cpu*, uint16_t port, uint8_t data){
+    this->map((uint8_t)(port - this->base) % this->window_count, data);
+}
+
+void Mmu::saveState(std::vector<uint8_t>& out, bool delta){
+    for (size_t window = 0; window < this->window_count; window++){
+        this->collectDirty(window);
+    }
+    if (! delta){
+        for (size_t page = 0; page < this->store.size() / DIRTY_SIZE; page++){
+            this->dirty[page >> 6] |= (uint64_t)1 << (page & 0x3f);
+        }
+    }
+    size_t count = 0;
+    for (uint64_t word : this->dirty){
+        count += __builtin_popcountll(word);
+    }
+
+    // page size, page count, window registers, store bitmap, then the selected 256-byte pages
+    uint32_t geometry[2] = {(uint32_t)this->page_size, (uint32_t)this->page_count};
+    size_t bitmap_size = this->dirty.size() * sizeof(uint64_t);
+    size_t start = out.size();
+    out.resize(start + sizeof(geometry) + this->window_count + bitmap_size + count * DIRTY_SIZE);
+    uint8_t* p = out.data() + start;
+    memcpy(p, geometry, sizeof(geometry));
+    p += sizeof(geometry);
+    memcpy(p, this->registers.data(), this->window_count);
+    p += this->window_count;
+    memcpy(p, this->dirty.data(), bitmap_size);
+    p += bitmap_size;
+
+    for (size_t w = 0; w < this->dirty.size(); w++){
+        uint64_t word = this->dirty[w];
+        while (word != 0){
+            size_t page = w * 64 + __builtin_ctzll(word);
+            memcpy(p, this->store.data() + page * DIRTY_SIZE, DIRTY_SIZE);
+            p += DIRTY_SIZE;
+            word &= word - 1;
+        }
+    }
+    std::fill(this->dirty.begin(), this->dirty.end(), 0);
+}
+
+bool Mmu::modified() const{
+    for (uint64_t word : this->dirty){
+        if (word != 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+void Mmu::checkState(const uint8_t* in, size_t size) const{
+    uint32_t geometry[2];
+    size_t bitmap_size = this->dirty.size() * sizeof(uint64_t);
+    if (size < sizeof(geometry) + this->window_count + bitmap_size){
+        throw std::runtime_error("Truncated snapshot (mmu)");
+    }
+    memcpy(geometry, in, sizeof(geometry));
+    if (geometry[0] != this->page_size || geometry[1] != this->page_count){
+        throw std::runtime_error("Snapshot MMU geometry does not match");
+    }
+    std::vector<uint64_t> pages(this->dirty.size());
+    memcpy(pages.data(), in + sizeof(geometry) + this->window_count, bitmap_size);
+    // Bits past the end of the store would write outside it
+    size_t tail = (this->store.size() / DIRTY_SIZE) & 0x3f;
+    if (tail != 0 && (pages.back() >> tail) != 0){
+        throw std::runtime_error("Invalid snapshot (mmu)");
+    }
+    size_t count = 0;
+    for (uint64_t word : pages){
+        count += __builtin_popcountll(word);
+    }
+    if (size < sizeof(geometry) + this->window_count + bitmap_size + count * DIRTY_SIZE){
+        throw std::runtime_error("Truncated snapshot (mmu)");
+    }
+}
+
+void Mmu::loadState(const uint8_t* in, size_t size){
+    this->checkState(in, size);
+    const uint8_t* p = in + 2 * sizeof(uint32_t);
+    memcpy(this->registers.data(), p, this->window_count);
+    p += this->window_count;
+    std::vector<uint64_t> pages(this->dirty.size());
+    size_t bitmap_size = pages.size() * sizeof(uint64_t);
+    memcpy(pages.data(), p, bitmap_size);
+    p += bitmap_size;
+
+    for (size_t w = 0; w < pages.size(); w++){
+        uint64_t word = pages[w];
+        while (word != 0){
+            size_t page = w * 64 + __builtin_ctzll(word);
+            memcpy(this->store.data() + page * DIRTY_SIZE, p, DIRTY_SIZE);
+            p += DIRTY_SIZE;
+            word &= word - 1;
+        }
+    }
+    for (size_t window = 0; window < this->window_count; window++){
+        this->install(window);
+    }
+    std::fill(this->dirty.begin(), this->dirty.end(), 0);
+}
@@ -0,0 +1,60 @@
+#ifndef Z80EMU_MMU_HPP
+#define Z80EMU_MMU_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "io.hpp"
+
+class Cpu;
+
+// Bank switched memory behind a set of window registers, as on the 512KB/1MB RAM boards.
+//
+// The 64KB address space is split into equal windows. Writing a window's port selects which
+// page of the backing store appears there. Selecting a page only rewrites the Cpu page table,
+// so an access costs the same shift and index with or without banking.
+class Mmu : public IoDevice {
+public:
+    static const size_t DEFAULT_PAGE_SIZE = 16384;
+
+    // store_size bytes of RAM in pages of page_size, a multiple of 4KB
+    explicit Mmu(size_t store_size, size_t page_size = DEFAULT_PAGE_SIZE);
+
+    // Takes over memory: the current 64KB becomes the first pages of the store, window i shows
+    // page i, and the window registers are claimed from base.
+    void attach(Cpu* cpu, uint8_t base);
+    void map(size_t window, size_t page);
+
+    size_t windows() const{ return this->window_count; }
+    size_t pages() const{ return this->page_count; }
+    size_t pageSize() const{ return this->page_size; }
+
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+    bool inSnapshot() const override{ return true; }
+
+    // Window registers and the store. A delta holds the 256-byte pages written since the last save.
+    void saveState(std::vector<uint8_t>& out, bool delta);
+    void loadState(const uint8_t* in, size_t size);
+    // Store pages written since the last saveState, beyond the Cpu dirty bits of the windows
+    bool modified() const;
+    // Throws like loadState on a state that does not fit this MMU, without changing anything
+    void checkState(const uint8_t* in, size_t size) const;
+
+private:
+    Cpu* cpu = nullptr;
+    uint8_t base = 0;
+    size_t page_size;
+    size_t page_count;
+    size_t window_count;
+    std::vector<uint8_t> store;
+    std::vector<uint8_t> registers;
+    // One bit per 256 bytes of the store
+    std::vector<uint64_t> dirty;
+
+    // Moves the Cpu dirty bits of a window to the store page it shows
+    void collectDirty(size_t window);
+    void install(size_t window);
+};
+
+#endif //Z80EMU_MMU_HPP
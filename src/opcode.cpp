@@ -4,6 +4,139 @@
 #include "mcycle.hpp"
 #include "stdexcept"
 #include "log.hpp"
+#include "bdos.hpp"
+#include "console.hpp"
+
+const uint16_t OpCode::DAATable[16 * 128] = {
+        0x0080, 0x0100, 0x0200, 0x0300, 0x0400, 0x0500, 0x0600, 0x0700, 0x0800, 0x0900, 0x1000, 0x1100, 0x1200, 0x1300, 0x1400, 0x1500,
+        0x1000, 0x1100, 0x1200, 0x1300, 0x1400, 0x1500, 0x1600, 0x1700, 0x1800, 0x1900, 0x2000, 0x2100, 0x2200, 0x2300, 0x2400, 0x2500,
+        0x2000, 0x2100, 0x2200, 0x2300, 0x2400, 0x2500, 0x2600, 0x2700, 0x2800, 0x2900, 0x3000, 0x3100, 0x3200, 0x3300, 0x3400, 0x3500,
+        0x3000, 0x3100, 0x3200, 0x3300, 0x3400, 0x3500, 0x3600, 0x3700, 0x3800, 0x3900, 0x4000, 0x4100, 0x4200, 0x4300, 0x4400, 0x4500,
+        0x4000, 0x4100, 0x4200, 0x4300, 0x4400, 0x4500, 0x4600, 0x4700, 0x4800, 0x4900, 0x5000, 0x5100, 0x5200, 0x5300, 0x5400, 0x5500,
+        0x5000, 0x5100, 0x5200, 0x5300, 0x5400, 0x5500, 0x5600, 0x5700, 0x5800, 0x5900, 0x6000, 0x6100, 0x6200, 0x6300, 0x6400, 0x6500,
+        0x6000, 0x6100, 0x6200, 0x6300, 0x6400, 0x6500, 0x6600, 0x6700, 0x6800, 0x6900, 0x7000, 0x7100, 0x7200, 0x7300, 0x7400, 0x7500,
+        0x7000, 0x7100, 0x7200, 0x7300, 0x7400, 0x7500, 0x7600, 0x7700, 0x7800, 0x7900, 0x8000, 0x8100, 0x8200, 0x8300, 0x8400, 0x8500,
+        0x8000, 0x8100, 0x8200, 0x8300, 0x8400, 0x8500, 0x8600, 0x8700, 0x8800, 0x8900, 0x9000, 0x9100, 0x9200, 0x9300, 0x9400, 0x9500,
+        0x9000, 0x9100, 0x9200, 0x9300, 0x9400, 0x9500, 0x9600, 0x9700, 0x9800, 0x9900, 0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510,
+        0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510, 0x0610, 0x0710, 0x0810, 0x0910, 0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510,
+        0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510, 0x1610, 0x1710, 0x1810, 0x1910, 0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510,
+        0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510, 0x2610, 0x2710, 0x2810, 0x2910, 0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510,
+        0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510, 0x3610, 0x3710, 0x3810, 0x3910, 0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510,
+        0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510, 0x4610, 0x4710, 0x4810, 0x4910, 0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510,
+        0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510, 0x5610, 0x5710, 0x5810, 0x5910, 0x6010, 0x6110, 0x6210, 0x6310, 0x6410, 0x6510,
+        0x6010, 0x6110, 0x6210, 0x6310, 0x6410, 0x6510, 0x6610, 0x6710, 0x6810, 0x6910, 0x7010, 0x7110, 0x7210, 0x7310, 0x7410, 0x7510,
+        0x7010, 0x7110, 0x7210, 0x7310, 0x7410, 0x7510, 0x7610, 0x7710, 0x7810, 0x7910, 0x8010, 0x8110, 0x8210, 0x8310, 0x8410, 0x8510,
+        0x8010, 0x8110, 0x8210, 0x8310, 0x8410, 0x8510, 0x8610, 0x8710, 0x8810, 0x8910, 0x9010, 0x9110, 0x9210, 0x9310, 0x9410, 0x9510,
+        0x9010, 0x9110, 0x9210, 0x9310, 0x9410, 0x9510, 0x9610, 0x9710, 0x9810, 0x9910, 0xA010, 0xA110, 0xA210, 0xA310, 0xA410, 0xA510,
+        0xA010, 0xA110, 0xA210, 0xA310, 0xA410, 0xA510, 0xA610, 0xA710, 0xA810, 0xA910, 0xB010, 0xB110, 0xB210, 0xB310, 0xB410, 0xB510,
+        0xB010, 0xB110, 0xB210, 0xB310, 0xB410, 0xB510, 0xB610, 0xB710, 0xB810, 0xB910, 0xC010, 0xC110, 0xC210, 0xC310, 0xC410, 0xC510,
+        0xC010, 0xC110, 0xC210, 0xC310, 0xC410, 0xC510, 0xC610, 0xC710, 0xC810, 0xC910, 0xD010, 0xD110, 0xD210, 0xD310, 0xD410, 0xD510,
+        0xD010, 0xD110, 0xD210, 0xD310, 0xD410, 0xD510, 0xD610, 0xD710, 0xD810, 0xD910, 0xE010, 0xE110, 0xE210, 0xE310, 0xE410, 0xE510,
+        0xE010, 0xE110, 0xE210, 0xE310, 0xE410, 0xE510, 0xE610, 0xE710, 0xE810, 0xE910, 0xF010, 0xF110, 0xF210, 0xF310, 0xF410, 0xF510,
+        0xF010, 0xF110, 0xF210, 0xF310, 0xF410, 0xF510, 0xF610, 0xF710, 0xF810, 0xF910, 0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510,
+        0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510, 0x0610, 0x0710, 0x0810, 0x0910, 0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510,
+        0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510, 0x1610, 0x1710, 0x1810, 0x1910, 0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510,
+        0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510, 0x2610, 0x2710, 0x2810, 0x2910, 0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510,
+        0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510, 0x3610, 0x3710, 0x3810, 0x3910, 0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510,
+        0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510, 0x4610, 0x4710, 0x4810, 0x4910, 0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510,
+        0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510, 0x5610, 0x5710, 0x5810, 0x5910, 0x6010, 0x6110, 0x6210, 0x6310, 0x6410, 0x6510,
+        0x0600, 0x0700, 0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00, 0x0F00, 0x1000, 0x1100, 0x1200, 0x1300, 0x1400, 0x1500,
+        0x1600, 0x1700, 0x1800, 0x1900, 0x1A00, 0x1B00, 0x1C00, 0x1D00, 0x1E00, 0x1F00, 0x2000, 0x2100, 0x2200, 0x2300, 0x2400, 0x2500,
+        0x2600, 0x2700, 0x2800, 0x2900, 0x2A00, 0x2B00, 0x2C00, 0x2D00, 0x2E00, 0x2F00, 0x3000, 0x3100, 0x3200, 0x3300, 0x3400, 0x3500,
+        0x3600, 0x3700, 0x3800, 0x3900, 0x3A00, 0x3B00, 0x3C00, 0x3D00, 0x3E00, 0x3F00, 0x4000, 0x4100, 0x4200, 0x4300, 0x4400, 0x4500,
+        0x4600, 0x4700, 0x4800, 0x4900, 0x4A00, 0x4B00, 0x4C00, 0x4D00, 0x4E00, 0x4F00, 0x5000, 0x5100, 0x5200, 0x5300, 0x5400, 0x5500,
+        0x5600, 0x5700, 0x5800, 0x5900, 0x5A00, 0x5B00, 0x5C00, 0x5D00, 0x5E00, 0x5F00, 0x6000, 0x6100, 0x6200, 0x6300, 0x6400, 0x6500,
+        0x6600, 0x6700, 0x6800, 0x6900, 0x6A00, 0x6B00, 0x6C00, 0x6D00, 0x6E00, 0x6F00, 0x7000, 0x7100, 0x7200, 0x7300, 0x7400, 0x7500,
+        0x7600, 0x7700, 0x7800, 0x7900, 0x7A00, 0x7B00, 0x7C00, 0x7D00, 0x7E00, 0x7F00, 0x8000, 0x8100, 0x8200, 0x8300, 0x8400, 0x8500,
+        0x8600, 0x8700, 0x8800, 0x8900, 0x8A00, 0x8B00, 0x8C00, 0x8D00, 0x8E00, 0x8F00, 0x9000, 0x9100, 0x9200, 0x9300, 0x9400, 0x9500,
+        0x9600, 0x9700, 0x9800, 0x9900, 0x9A00, 0x9B00, 0x9C00, 0x9D00, 0x9E00, 0x9F00, 0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510,
+        0x0610, 0x0710, 0x0810, 0x0910, 0x0A10, 0x0B10, 0x0C10, 0x0D10, 0x0E10, 0x0F10, 0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510,
+        0x1610, 0x1710, 0x1810, 0x1910, 0x1A10, 0x1B10, 0x1C10, 0x1D10, 0x1E10, 0x1F10, 0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510,
+        0x2610, 0x2710, 0x2810, 0x2910, 0x2A10, 0x2B10, 0x2C10, 0x2D10, 0x2E10, 0x2F10, 0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510,
+        0x3610, 0x3710, 0x3810, 0x3910, 0x3A10, 0x3B10, 0x3C10, 0x3D10, 0x3E10, 0x3F10, 0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510,
+        0x4610, 0x4710, 0x4810, 0x4910, 0x4A10, 0x4B10, 0x4C10, 0x4D10, 0x4E10, 0x4F10, 0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510,
+        0x5610, 0x5710, 0x5810, 0x5910, 0x5A10, 0x5B10, 0x5C10, 0x5D10, 0x5E10, 0x5F10, 0x6010, 0x6110, 0x6210, 0x6310, 0x6410, 0x6510,
+        0x6610, 0x6710, 0x6810, 0x6910, 0x6A10, 0x6B10, 0x6C10, 0x6D10, 0x6E10, 0x6F10, 0x7010, 0x7110, 0x7210, 0x7310, 0x7410, 0x7510,
+        0x7610, 0x7710, 0x7810, 0x7910, 0x7A10, 0x7B10, 0x7C10, 0x7D10, 0x7E10, 0x7F10, 0x8010, 0x8110, 0x8210, 0x8310, 0x8410, 0x8510,
+        0x8610, 0x8710, 0x8810, 0x8910, 0x8A10, 0x8B10, 0x8C10, 0x8D10, 0x8E10, 0x8F10, 0x9010, 0x9110, 0x9210, 0x9310, 0x9410, 0x9510,
+        0x9610, 0x9710, 0x9810, 0x9910, 0x9A10, 0x9B10, 0x9C10, 0x9D10, 0x9E10, 0x9F10, 0xA010, 0xA110, 0xA210, 0xA310, 0xA410, 0xA510,
+        0xA610, 0xA710, 0xA810, 0xA910, 0xAA10, 0xAB10, 0xAC10, 0xAD10, 0xAE10, 0xAF10, 0xB010, 0xB110, 0xB210, 0xB310, 0xB410, 0xB510,
+        0xB610, 0xB710, 0xB810, 0xB910, 0xBA10, 0xBB10, 0xBC10, 0xBD10, 0xBE10, 0xBF10, 0xC010, 0xC110, 0xC210, 0xC310, 0xC410, 0xC510,
+        0xC610, 0xC710, 0xC810, 0xC910, 0xCA10, 0xCB10, 0xCC10, 0xCD10, 0xCE10, 0xCF10, 0xD010, 0xD110, 0xD210, 0xD310, 0xD410, 0xD510,
+        0xD610, 0xD710, 0xD810, 0xD910, 0xDA10, 0xDB10, 0xDC10, 0xDD10, 0xDE10, 0xDF10, 0xE010, 0xE110, 0xE210, 0xE310, 0xE410, 0xE510,
+        0xE610, 0xE710, 0xE810, 0xE910, 0xEA10, 0xEB10, 0xEC10, 0xED10, 0xEE10, 0xEF10, 0xF010, 0xF110, 0xF210, 0xF310, 0xF410, 0xF510,
+        0xF610, 0xF710, 0xF810, 0xF910, 0xFA10, 0xFB10, 0xFC10, 0xFD10, 0xFE10, 0xFF10, 0x0090, 0x0110, 0x0210, 0x0310, 0x0410, 0x0510,
+        0x0610, 0x0710, 0x0810, 0x0910, 0x0A10, 0x0B10, 0x0C10, 0x0D10, 0x0E10, 0x0F10, 0x1010, 0x1110, 0x1210, 0x1310, 0x1410, 0x1510,
+        0x1610, 0x1710, 0x1810, 0x1910, 0x1A10, 0x1B10, 0x1C10, 0x1D10, 0x1E10, 0x1F10, 0x2010, 0x2110, 0x2210, 0x2310, 0x2410, 0x2510,
+        0x2610, 0x2710, 0x2810, 0x2910, 0x2A10, 0x2B10, 0x2C10, 0x2D10, 0x2E10, 0x2F10, 0x3010, 0x3110, 0x3210, 0x3310, 0x3410, 0x3510,
+        0x3610, 0x3710, 0x3810, 0x3910, 0x3A10, 0x3B10, 0x3C10, 0x3D10, 0x3E10, 0x3F10, 0x4010, 0x4110, 0x4210, 0x4310, 0x4410, 0x4510,
+        0x4610, 0x4710, 0x4810, 0x4910, 0x4A10, 0x4B10, 0x4C10, 0x4D10, 0x4E10, 0x4F10, 0x5010, 0x5110, 0x5210, 0x5310, 0x5410, 0x5510,
+        0x5610, 0x5710, 0x5810, 0x5910, 0x5A10, 0x5B10, 0x5C10, 0x5D10, 0x5E10, 0x5F10, 0x6010, 0x6110, 0x6210, 0x6310, 0x6410, 0x6510,
+        0x00C0, 0x0140, 0x0240, 0x0340, 0x0440, 0x0540, 0x0640, 0x0740, 0x0840, 0x0940, 0x0A40, 0x0B40, 0x0C40, 0x0D40, 0x0E40, 0x0F40,
+        0x1040, 0x1140, 0x1240, 0x1340, 0x1440, 0x1540, 0x1640, 0x1740, 0x1840, 0x1940, 0x1A40, 0x1B40, 0x1C40, 0x1D40, 0x1E40, 0x1F40,
+        0x2040, 0x2140, 0x2240, 0x2340, 0x2440, 0x2540, 0x2640, 0x2740, 0x2840, 0x2940, 0x2A40, 0x2B40, 0x2C40, 0x2D40, 0x2E40, 0x2F40,
+        0x3040, 0x3140, 0x3240, 0x3340, 0x3440, 0x3540, 0x3640, 0x3740, 0x3840, 0x3940, 0x3A40, 0x3B40, 0x3C40, 0x3D40, 0x3E40, 0x3F40,
+        0x4040, 0x4140, 0x4240, 0x4340, 0x4440, 0x4540, 0x4640, 0x4740, 0x4840, 0x4940, 0x4A40, 0x4B40, 0x4C40, 0x4D40, 0x4E40, 0x4F40,
+        0x5040, 0x5140, 0x5240, 0x5340, 0x5440, 0x5540, 0x5640, 0x5740, 0x5840, 0x5940, 0x5A40, 0x5B40, 0x5C40, 0x5D40, 0x5E40, 0x5F40,
+        0x6040, 0x6140, 0x6240, 0x6340, 0x6440, 0x6540, 0x6640, 0x6740, 0x6840, 0x6940, 0x6A40, 0x6B40, 0x6C40, 0x6D40, 0x6E40, 0x6F40,
+        0x7040, 0x7140, 0x7240, 0x7340, 0x7440, 0x7540, 0x7640, 0x7740, 0x7840, 0x7940, 0x7A40, 0x7B40, 0x7C40, 0x7D40, 0x7E40, 0x7F40,
+        0x8040, 0x8140, 0x8240, 0x8340, 0x8440, 0x8540, 0x8640, 0x8740, 0x8840, 0x8940, 0x8A40, 0x8B40, 0x8C40, 0x8D40, 0x8E40, 0x8F40,
+        0x9040, 0x9140, 0x9240, 0x9340, 0x9440, 0x9540, 0x9640, 0x9740, 0x9840, 0x9940, 0x9A40, 0x9B40, 0x9C40, 0x9D40, 0x9E40, 0x9F40,
+        0xA040, 0xA140, 0xA240, 0xA340, 0xA440, 0xA540, 0xA640, 0xA740, 0xA840, 0xA940, 0xAA40, 0xAB40, 0xAC40, 0xAD40, 0xAE40, 0xAF40,
+        0xB040, 0xB140, 0xB240, 0xB340, 0xB440, 0xB540, 0xB640, 0xB740, 0xB840, 0xB940, 0xBA40, 0xBB40, 0xBC40, 0xBD40, 0xBE40, 0xBF40,
+        0xC040, 0xC140, 0xC240, 0xC340, 0xC440, 0xC540, 0xC640, 0xC740, 0xC840, 0xC940, 0xCA40, 0xCB40, 0xCC40, 0xCD40, 0xCE40, 0xCF40,
+        0xD040, 0xD140, 0xD240, 0xD340, 0xD440, 0xD540, 0xD640, 0xD740, 0xD840, 0xD940, 0xDA40, 0xDB40, 0xDC40, 0xDD40, 0xDE40, 0xDF40,
+        0xE040, 0xE140, 0xE240, 0xE340, 0xE440, 0xE540, 0xE640, 0xE740, 0xE840, 0xE940, 0xEA40, 0xEB40, 0xEC40, 0xED40, 0xEE40, 0xEF40,
+        0xF040, 0xF140, 0xF240, 0xF340, 0xF440, 0xF540, 0xF640, 0xF740, 0xF840, 0xF940, 0xFA40, 0xFB40, 0xFC40, 0xFD40, 0xFE40, 0xFF40,
+        0xA050, 0xA150, 0xA250, 0xA350, 0xA450, 0xA550, 0xA650, 0xA750, 0xA850, 0xA950, 0xAA50, 0xAB50, 0xAC50, 0xAD50, 0xAE50, 0xAF50,
+        0xB050, 0xB150, 0xB250, 0xB350, 0xB450, 0xB550, 0xB650, 0xB750, 0xB850, 0xB950, 0xBA50, 0xBB50, 0xBC50, 0xBD50, 0xBE50, 0xBF50,
+        0xC050, 0xC150, 0xC250, 0xC350, 0xC450, 0xC550, 0xC650, 0xC750, 0xC850, 0xC950, 0xCA50, 0xCB50, 0xCC50, 0xCD50, 0xCE50, 0xCF50,
+        0xD050, 0xD150, 0xD250, 0xD350, 0xD450, 0xD550, 0xD650, 0xD750, 0xD850, 0xD950, 0xDA50, 0xDB50, 0xDC50, 0xDD50, 0xDE50, 0xDF50,
+        0xE050, 0xE150, 0xE250, 0xE350, 0xE450, 0xE550, 0xE650, 0xE750, 0xE850, 0xE950, 0xEA50, 0xEB50, 0xEC50, 0xED50, 0xEE50, 0xEF50,
+        0xF050, 0xF150, 0xF250, 0xF350, 0xF450, 0xF550, 0xF650, 0xF750, 0xF850, 0xF950, 0xFA50, 0xFB50, 0xFC50, 0xFD50, 0xFE50, 0xFF50,
+        0x00D0, 0x0150, 0x0250, 0x0350, 0x0450, 0x0550, 0x0650, 0x0750, 0x0850, 0x0950, 0x0A50, 0x0B50, 0x0C50, 0x0D50, 0x0E50, 0x0F50,
+        0x1050, 0x1150, 0x1250, 0x1350, 0x1450, 0x1550, 0x1650, 0x1750, 0x1850, 0x1950, 0x1A50, 0x1B50, 0x1C50, 0x1D50, 0x1E50, 0x1F50,
+        0x2050, 0x2150, 0x2250, 0x2350, 0x2450, 0x2550, 0x2650, 0x2750, 0x2850, 0x2950, 0x2A50, 0x2B50, 0x2C50, 0x2D50, 0x2E50, 0x2F50,
+        0x3050, 0x3150, 0x3250, 0x3350, 0x3450, 0x3550, 0x3650, 0x3750, 0x3850, 0x3950, 0x3A50, 0x3B50, 0x3C50, 0x3D50, 0x3E50, 0x3F50,
+        0x4050, 0x4150, 0x4250, 0x4350, 0x4450, 0x4550, 0x4650, 0x4750, 0x4850, 0x4950, 0x4A50, 0x4B50, 0x4C50, 0x4D50, 0x4E50, 0x4F50,
+        0x5050, 0x5150, 0x5250, 0x5350, 0x5450, 0x5550, 0x5650, 0x5750, 0x5850, 0x5950, 0x5A50, 0x5B50, 0x5C50, 0x5D50, 0x5E50, 0x5F50,
+        0x6050, 0x6150, 0x6250, 0x6350, 0x6450, 0x6550, 0x6650, 0x6750, 0x6850, 0x6950, 0x6A50, 0x6B50, 0x6C50, 0x6D50, 0x6E50, 0x6F50,
+        0x7050, 0x7150, 0x7250, 0x7350, 0x7450, 0x7550, 0x7650, 0x7750, 0x7850, 0x7950, 0x7A50, 0x7B50, 0x7C50, 0x7D50, 0x7E50, 0x7F50,
+        0x8050, 0x8150, 0x8250, 0x8350, 0x8450, 0x8550, 0x8650, 0x8750, 0x8850, 0x8950, 0x8A50, 0x8B50, 0x8C50, 0x8D50, 0x8E50, 0x8F50,
+        0x9050, 0x9150, 0x9250, 0x9350, 0x9450, 0x9550, 0x9650, 0x9750, 0x9850, 0x9950, 0x9A50, 0x9B50, 0x9C50, 0x9D50, 0x9E50, 0x9F50,
+        0xFA40, 0xFB40, 0xFC40, 0xFD40, 0xFE40, 0xFF40, 0x00C0, 0x0140, 0x0240, 0x0340, 0x0440, 0x0540, 0x0640, 0x0740, 0x0840, 0x0940,
+        0x0A40, 0x0B40, 0x0C40, 0x0D40, 0x0E40, 0x0F40, 0x1040, 0x1140, 0x1240, 0x1340, 0x1440, 0x1540, 0x1640, 0x1740, 0x1840, 0x1940,
+        0x1A40, 0x1B40, 0x1C40, 0x1D40, 0x1E40, 0x1F40, 0x2040, 0x2140, 0x2240, 0x2340, 0x2440, 0x2540, 0x2640, 0x2740, 0x2840, 0x2940,
+        0x2A40, 0x2B40, 0x2C40, 0x2D40, 0x2E40, 0x2F40, 0x3040, 0x3140, 0x3240, 0x3340, 0x3440, 0x3540, 0x3640, 0x3740, 0x3840, 0x3940,
+        0x3A40, 0x3B40, 0x3C40, 0x3D40, 0x3E40, 0x3F40, 0x4040, 0x4140, 0x4240, 0x4340, 0x4440, 0x4540, 0x4640, 0x4740, 0x4840, 0x4940,
+        0x4A40, 0x4B40, 0x4C40, 0x4D40, 0x4E40, 0x4F40, 0x5040, 0x5140, 0x5240, 0x5340, 0x5440, 0x5540, 0x5640, 0x5740, 0x5840, 0x5940,
+        0x5A40, 0x5B40, 0x5C40, 0x5D40, 0x5E40, 0x5F40, 0x6040, 0x6140, 0x6240, 0x6340, 0x6440, 0x6540, 0x6640, 0x6740, 0x6840, 0x6940,
+        0x6A40, 0x6B40, 0x6C40, 0x6D40, 0x6E40, 0x6F40, 0x7040, 0x7140, 0x7240, 0x7340, 0x7440, 0x7540, 0x7640, 0x7740, 0x7840, 0x7940,
+        0x7A40, 0x7B40, 0x7C40, 0x7D40, 0x7E40, 0x7F40, 0x8040, 0x8140, 0x8240, 0x8340, 0x8440, 0x8540, 0x8640, 0x8740, 0x8840, 0x8940,
+        0x8A40, 0x8B40, 0x8C40, 0x8D40, 0x8E40, 0x8F40, 0x9040, 0x9140, 0x9240, 0x9340, 0x9440, 0x9540, 0x9640, 0x9740, 0x9840, 0x9940,
+        0x9A40, 0x9B40, 0x9C40, 0x9D40, 0x9E40, 0x9F40, 0xA040, 0xA140, 0xA240, 0xA340, 0xA440, 0xA540, 0xA640, 0xA740, 0xA840, 0xA940,
+        0xAA40, 0xAB40, 0xAC40, 0xAD40, 0xAE40, 0xAF40, 0xB040, 0xB140, 0xB240, 0xB340, 0xB440, 0xB540, 0xB640, 0xB740, 0xB840, 0xB940,
+        0xBA40, 0xBB40, 0xBC40, 0xBD40, 0xBE40, 0xBF40, 0xC040, 0xC140, 0xC240, 0xC340, 0xC440, 0xC540, 0xC640, 0xC740, 0xC840, 0xC940,
+        0xCA40, 0xCB40, 0xCC40, 0xCD40, 0xCE40, 0xCF40, 0xD040, 0xD140, 0xD240, 0xD340, 0xD440, 0xD540, 0xD640, 0xD740, 0xD840, 0xD940,
+        0xDA40, 0xDB40, 0xDC40, 0xDD40, 0xDE40, 0xDF40, 0xE040, 0xE140, 0xE240, 0xE340, 0xE440, 0xE540, 0xE640, 0xE740, 0xE840, 0xE940,
+        0xEA40, 0xEB40, 0xEC40, 0xED40, 0xEE40, 0xEF40, 0xF040, 0xF140, 0xF240, 0xF340, 0xF440, 0xF540, 0xF640, 0xF740, 0xF840, 0xF940,
+        0x9A50, 0x9B50, 0x9C50, 0x9D50, 0x9E50, 0x9F50, 0xA050, 0xA150, 0xA250, 0xA350, 0xA450, 0xA550, 0xA650, 0xA750, 0xA850, 0xA950,
+        0xAA50, 0xAB50, 0xAC50, 0xAD50, 0xAE50, 0xAF50, 0xB050, 0xB150, 0xB250, 0xB350, 0xB450, 0xB550, 0xB650, 0xB750, 0xB850, 0xB950,
+        0xBA50, 0xBB50, 0xBC50, 0xBD50, 0xBE50, 0xBF50, 0xC050, 0xC150, 0xC250, 0xC350, 0xC450, 0xC550, 0xC650, 0xC750, 0xC850, 0xC950,
+        0xCA50, 0xCB50, 0xCC50, 0xCD50, 0xCE50, 0xCF50, 0xD050, 0xD150, 0xD250, 0xD350, 0xD450, 0xD550, 0xD650, 0xD750, 0xD850, 0xD950,
+        0xDA50, 0xDB50, 0xDC50, 0xDD50, 0xDE50, 0xDF50, 0xE050, 0xE150, 0xE250, 0xE350, 0xE450, 0xE550, 0xE650, 0xE750, 0xE850, 0xE950,
+        0xEA50, 0xEB50, 0xEC50, 0xED50, 0xEE50, 0xEF50, 0xF050, 0xF150, 0xF250, 0xF350, 0xF450, 0xF550, 0xF650, 0xF750, 0xF850, 0xF950,
+        0xFA50, 0xFB50, 0xFC50, 0xFD50, 0xFE50, 0xFF50, 0x00D0, 0x0150, 0x0250, 0x0350, 0x0450, 0x0550, 0x0650, 0x0750, 0x0850, 0x0950,
+        0x0A50, 0x0B50, 0x0C50, 0x0D50, 0x0E50, 0x0F50, 0x1050, 0x1150, 0x1250, 0x1350, 0x1450, 0x1550, 0x1650, 0x1750, 0x1850, 0x1950,
+        0x1A50, 0x1B50, 0x1C50, 0x1D50, 0x1E50, 0x1F50, 0x2050, 0x2150, 0x2250, 0x2350, 0x2450, 0x2550, 0x2650, 0x2750, 0x2850, 0x2950,
+        0x2A50, 0x2B50, 0x2C50, 0x2D50, 0x2E50, 0x2F50, 0x3050, 0x3150, 0x3250, 0x3350, 0x3450, 0x3550, 0x3650, 0x3750, 0x3850, 0x3950,
+        0x3A50, 0x3B50, 0x3C50, 0x3D50, 0x3E50, 0x3F50, 0x4050, 0x4150, 0x4250, 0x4350, 0x4450, 0x4550, 0x4650, 0x4750, 0x4850, 0x4950,
+        0x4A50, 0x4B50, 0x4C50, 0x4D50, 0x4E50, 0x4F50, 0x5050, 0x5150, 0x5250, 0x5350, 0x5450, 0x5550, 0x5650, 0x5750, 0x5850, 0x5950,
+        0x5A50, 0x5B50, 0x5C50, 0x5D50, 0x5E50, 0x5F50, 0x6050, 0x6150, 0x6250, 0x6350, 0x6450, 0x6550, 0x6650, 0x6750, 0x6850, 0x6950,
+        0x6A50, 0x6B50, 0x6C50, 0x6D50, 0x6E50, 0x6F50, 0x7050, 0x7150, 0x7250, 0x7350, 0x7450, 0x7550, 0x7650, 0x7750, 0x7850, 0x7950,
+        0x7A50, 0x7B50, 0x7C50, 0x7D50, 0x7E50, 0x7F50, 0x8050, 0x8150, 0x8250, 0x8350, 0x8450, 0x8550, 0x8650, 0x8750, 0x8850, 0x8950,
+        0x8A50, 0x8B50, 0x8C50, 0x8D50, 0x8E50, 0x8F50, 0x9050, 0x9150, 0x9250, 0x9350, 0x9450, 0x9550, 0x9650, 0x9750, 0x9850, 0x9950,
+};
 
 OpCode::OpCode() {
     this->_cpu = nullptr;
@@ -1899,6 +2032,7 @@ void OpCode::executeEd(uint8_t opCode){
         case 0x4D: // reti
             Log::execute(this->_cpu, opCode, "reti");
             executeRet();
+            this->_cpu->io_map.interruptReturn(this->_cpu->tick);
             break;
         case 0x4F: // ld r, a
             Log::execute(this->_cpu, opCode, "ld r, a");
@@ -2022,22 +2156,14 @@ void OpCode::executeEd(uint8_t opCode){
         }
         case 0xA2: { // ini
             Log::execute(this->_cpu, opCode, "ini");
-            uint8_t value = Mcycle::in(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b);
-            Mcycle::m3(this->_cpu, this->_cpu->registers.hl(), value);
-            this->_cpu->registers.b--;
-            this->_cpu->registers.hl(this->_cpu->registers.hl() + 1);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = (this->_cpu->registers.b == 0);
+            this->blockInput(1);
+            this->_cpu->tick += BLOCK_IO_EXTRA_TSTATES;
             break;
         }
         case 0xA3: { // outi
             Log::execute(this->_cpu, opCode, "outi");
-            uint8_t value = Mcycle::m2(this->_cpu, this->_cpu->registers.hl());
-            Mcycle::out(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b, value);
-            this->_cpu->registers.b--;
-            this->_cpu->registers.hl(this->_cpu->registers.hl() + 1);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = (this->_cpu->registers.b == 0);
+            this->blockOutput(1);
+            this->_cpu->tick += BLOCK_IO_EXTRA_TSTATES;
             break;
         }
         case 0xA8: { // ldd
@@ -2063,22 +2189,14 @@ void OpCode::executeEd(uint8_t opCode){
         }
         case 0xAA: { // ind
             Log::execute(this->_cpu, opCode, "ind");
-            uint8_t value = Mcycle::in(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b);
-            Mcycle::m3(this->_cpu, this->_cpu->registers.hl(), value);
-            this->_cpu->registers.b--;
-            this->_cpu->registers.hl(this->_cpu->registers.hl() - 1);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = (this->_cpu->registers.b == 0);
+            this->blockInput(-1);
+            this->_cpu->tick += BLOCK_IO_EXTRA_TSTATES;
             break;
         }
         case 0xAB: { // outd
             Log::execute(this->_cpu, opCode, "outd");
-            uint8_t value = Mcycle::m2(this->_cpu, this->_cpu->registers.hl());
-            Mcycle::out(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b, value);
-            this->_cpu->registers.b--;
-            this->_cpu->registers.hl(this->_cpu->registers.hl() - 1);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = (this->_cpu->registers.b == 0);
+            this->blockOutput(-1);
+            this->_cpu->tick += BLOCK_IO_EXTRA_TSTATES;
             break;
         }
         case 0xB0: { // ldir
@@ -2113,26 +2231,26 @@ void OpCode::executeEd(uint8_t opCode){
         }
         case 0xB2: { // inir
             Log::execute(this->_cpu, opCode, "inir");
+            if (this->blockTransfer(true, 1)){
+                break;
+            }
             do {
-                uint8_t value = Mcycle::in(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b);
-                Mcycle::m3(this->_cpu, this->_cpu->registers.hl(), value);
-                this->_cpu->registers.b--;
-                this->_cpu->registers.hl(this->_cpu->registers.hl() + 1);
+                this->blockInput(1);
+                // Every pass but the last goes round again
+                this->_cpu->tick += (this->_cpu->registers.b != 0) ? BLOCK_REPEAT_TSTATES : BLOCK_IO_EXTRA_TSTATES;
             } while(this->_cpu->registers.b > 0);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = true;
             break;
         }
         case 0xB3: { // otir
             Log::execute(this->_cpu, opCode, "otir");
+            if (this->blockTransfer(false, 1)){
+                break;
+            }
             do {
-                uint8_t value = Mcycle::m2(this->_cpu, this->_cpu->registers.hl());
-                Mcycle::out(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b, value);
-                this->_cpu->registers.b--;
-                this->_cpu->registers.hl(this->_cpu->registers.hl() + 1);
+                this->blockOutput(1);
+                // Every pass but the last goes round again
+                this->_cpu->tick += (this->_cpu->registers.b != 0) ? BLOCK_REPEAT_TSTATES : BLOCK_IO_EXTRA_TSTATES;
             } while(this->_cpu->registers.b > 0);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = true;
             break;
         }
         case 0xB8: { // lddr
@@ -2162,26 +2280,26 @@ void OpCode::executeEd(uint8_t opCode){
         }
         case 0xBA: { // indr
             Log::execute(this->_cpu, opCode, "indr");
+            if (this->blockTransfer(true, -1)){
+                break;
+            }
             do {
-                uint8_t value = Mcycle::in(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b);
-                Mcycle::m3(this->_cpu, this->_cpu->registers.hl(), value);
-                this->_cpu->registers.b--;
-                this->_cpu->registers.hl(this->_cpu->registers.hl() - 1);
+                this->blockInput(-1);
+                // Every pass but the last goes round again
+                this->_cpu->tick += (this->_cpu->registers.b != 0) ? BLOCK_REPEAT_TSTATES : BLOCK_IO_EXTRA_TSTATES;
             } while(this->_cpu->registers.b > 0);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = true;
             break;
         }
         case 0xBB: { // otdr
             Log::execute(this->_cpu, opCode, "otdr");
+            if (this->blockTransfer(false, -1)){
+                break;
+            }
             do {
-                uint8_t value = Mcycle::m2(this->_cpu, this->_cpu->registers.hl());
-                Mcycle::out(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b, value);
-                this->_cpu->registers.b--;
-                this->_cpu->registers.hl(this->_cpu->registers.hl() - 1);
+                this->blockOutput(-1);
+                // Every pass but the last goes round again
+                this->_cpu->tick += (this->_cpu->registers.b != 0) ? BLOCK_REPEAT_TSTATES : BLOCK_IO_EXTRA_TSTATES;
             } while(this->_cpu->registers.b > 0);
-            this->_cpu->registers.FN_Subtract = true;
-            this->_cpu->registers.FZ_Zero = true;
             break;
         }
         default: {
@@ -2193,6 +2311,118 @@ void OpCode::executeEd(uint8_t opCode){
     }
 }
 
+void OpCode::blockInput(int step){
+    uint8_t value = Mcycle::in(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b);
+    Mcycle::m3(this->_cpu, this->_cpu->registers.hl(), value);
+    this->_cpu->registers.b--;
+    this->_cpu->registers.hl(this->_cpu->registers.hl() + step);
+    this->setFlagsByBlockIO(value, value + (uint8_t)(this->_cpu->registers.c + step));
+}
+
+void OpCode::blockOutput(int step){
+    // B is decremented before it goes out on the high address lines
+    uint8_t value = Mcycle::m2(this->_cpu, this->_cpu->registers.hl());
+    this->_cpu->registers.b--;
+    Mcycle::out(this->_cpu, this->_cpu->registers.c, this->_cpu->registers.b, value);
+    this->_cpu->registers.hl(this->_cpu->registers.hl() + step);
+    this->setFlagsByBlockIO(value, value + this->_cpu->registers.l);
+}
+
+void OpCode::setFlagsByBlockIO(uint8_t value, uint16_t k){
+    // refs: The Undocumented Z80 Documented, 4.3
+    uint8_t b = this->_cpu->registers.b;
+    this->_cpu->registers.FS_Sign = (b & 0x80) != 0;
+    this->_cpu->registers.FZ_Zero = (b == 0);
+    this->setFlagsXY(b);
+    this->_cpu->registers.FN_Subtract = (value & 0x80) != 0;
+    this->_cpu->registers.FH_HalfCarry = (k > 0xff);
+    this->_cpu->registers.FC_Carry = (k > 0xff);
+    this->_cpu->registers.FPV_ParityOverflow = this->parity((k & 0x07) ^ b);
+}
+
+bool OpCode::blockTransfer(bool input, int step){
+    // Host memory only, and nobody watching single accesses
+    if (! this->_cpu->enable_virtual_memory || this->_cpu->debug_active || this->_cpu->log_sink != nullptr){
+        return false;
+    }
+    uint8_t b = this->_cpu->registers.b;
+    // Inputs put B on the high address lines before the decrement, outputs after it
+    uint16_t port = ((uint8_t)(input ? b : b - 1) << 8) | this->_cpu->registers.c;
+    IoDevice* device = this->_cpu->io_map.find(port);
+    if (device == nullptr){
+        return false;
+    }
+    size_t count = (b == 0) ? 256 : b;
+    if (this->_cpu->io_map.fullDecode()){
+        // Every port on the way must be the same device
+        for (size_t i = 1; i < count; i++){
+            if (this->_cpu->io_map.find((uint16_t)(port - (i << 8))) != device){
+                count = i;
+                break;
+            }
+        }
+    }
+    uint16_t hl = this->_cpu->registers.hl();
+    // Memory mapped devices on the bus take single accesses
+    if (this->_cpu->onBus((step > 0) ? hl : (uint16_t)(hl - count + 1), count)){
+        return false;
+    }
+    // Chunks up to the end of each host page in the direction of travel. The device may stop early.
+    size_t moved = 0;
+    while (moved < count){
+        uint16_t at = (uint16_t)(hl + (int)moved * step);
+        size_t room = (step > 0) ? Cpu::PAGE_MASK + 1 - (at & Cpu::PAGE_MASK) : (size_t)(at & Cpu::PAGE_MASK) + 1;
+        size_t chunk = std::min(count - moved, room);
+        uint8_t* memory = &this->_cpu->memory(at);
+        // Descending runs go through a buffer, so devices always see bytes in transfer order
+        uint8_t reversed[256];
+        size_t done;
+        if (input){
+            done = device->readBlock(this->_cpu, port, (step > 0) ? memory : reversed, chunk);
+            for (size_t i = 0; step < 0 && i < done; i++){
+                *(memory - i) = reversed[i];
+            }
+        } else {
+            for (size_t i = 0; step < 0 && i < chunk; i++){
+                reversed[i] = *(memory - i);
+            }
+            done = device->writeBlock(this->_cpu, port, (step > 0) ? memory : reversed, chunk);
+        }
+        if (input && done > 0){
+            this->_cpu->idle_loop.written();
+            uint16_t low = (step > 0) ? at : (uint16_t)(at - done + 1);
+            for (uint32_t page = low >> 8; page <= (uint32_t)(low + done - 1) >> 8; page++){
+                this->_cpu->dirty_pages[page >> 6] |= (uint64_t)1 << (page & 0x3f);
+            }
+        }
+        moved += done;
+        if (done < chunk){
+            break;
+        }
+    }
+    if (moved == 0){
+        return false;
+    }
+    // Flags come from the last byte, as after the byte loop
+    uint8_t value = this->_cpu->memory((uint16_t)(hl + (int)(moved - 1) * step));
+    this->_cpu->registers.b -= (uint8_t)moved;
+    this->_cpu->registers.hl((uint16_t)(hl + (int)moved * step));
+    if (input){
+        this->setFlagsByBlockIO(value, value + (uint8_t)(this->_cpu->registers.c + step));
+    } else {
+        this->setFlagsByBlockIO(value, value + this->_cpu->registers.l);
+    }
+    // An I/O and a memory access per byte, and the repeat on every pass but the last
+    bool finished = (this->_cpu->registers.b == 0);
+    this->_cpu->tick += (7 + BLOCK_REPEAT_TSTATES) * moved;
+    if (finished){
+        this->_cpu->tick -= BLOCK_REPEAT_TSTATES - BLOCK_IO_EXTRA_TSTATES;
+    }
+    this->_cpu->metrics.mcycles[input ? Metrics::MCYCLE_IO_READ : Metrics::MCYCLE_IO_WRITE] += moved;
+    this->_cpu->metrics.mcycles[input ? Metrics::MCYCLE_MEM_WRITE : Metrics::MCYCLE_MEM_READ] += moved;
+    return finished;
+}
+
 void OpCode::executeFd(uint8_t opCode){
     if ((opCode >> 6) == 0b01 && ((opCode & 0b00111000) >> 3) != 0b110 && (opCode & 0b00000111) != 0b110){
         uint8_t reg_src = (opCode & 0b00000111);
@@ -2618,43 +2848,154 @@ void OpCode::executeCall(){
             Mcycle::m2(this->_cpu, this->_cpu->special_registers.pc) +
             (Mcycle::m2(this->_cpu, this->_cpu->special_registers.pc + 1) << 8);
     this->_cpu->special_registers.pc += 2;
-    if (! (this->_cpu->emulate_cpm_bdos_call && (jump_addr == 0x0000 || jump_addr == 0x0005))){
-        this->_cpu->special_registers.sp--;
-        Mcycle::m3(this->_cpu, this->_cpu->special_registers.sp, this->_cpu->special_registers.pc >> 8);
-        this->_cpu->special_registers.sp--;
-        Mcycle::m3(this->_cpu, this->_cpu->special_registers.sp, this->_cpu->special_registers.pc & 0xff);
-        this->_cpu->special_registers.pc = jump_addr;
-    } else {
-        // CP/M Warm boot
-        if (jump_addr == 0x0000){
-            throw std::runtime_error("CP/M Warm boot");
-        }
-        // CP/M BDOS system calls
-        Log::dump_registers(this->_cpu);
-        switch (this->_cpu->registers.c){
-            case 0x02:
-                // Console output
-                printf("CP/M BDOS call 0x02 Console output: %c\n", this->_cpu->registers.e);
+    this->_cpu->special_registers.sp--;
+    Mcycle::m3(this->_cpu, this->_cpu->special_registers.sp, this->_cpu->special_registers.pc >> 8);
+    this->_cpu->special_registers.sp--;
+    Mcycle::m3(this->_cpu, this->_cpu->special_registers.sp, this->_cpu->special_registers.pc & 0xff);
+    this->_cpu->special_registers.pc = jump_addr;
+}
+
+bool OpCode::executeBdos(){
+    this->bdos_wait = false;
+    // CP/M BDOS system calls
+    Log::dump_registers(this->_cpu);
+    Console* console = this->_cpu->console;
+    switch (this->_cpu->registers.c){
+        case 0x00:
+            // System reset
+            Log::general(this->_cpu, "CP/M System reset");
+            this->_cpu->stopped = true;
+            break;
+        case 0x01: {
+            // Console input, with echo
+            int chr = this->consoleInput();
+            if (chr < 0){
                 break;
-            case 0x09: {
-                // Output string
-                printf("CP/M BDOS call 0x09 Output string: ");
-                uint8_t chr;
-                do {
-                    chr = Mcycle::m2(this->_cpu, this->_cpu->registers.de());
-                    this->_cpu->registers.de(this->_cpu->registers.de() + 1);
-                    if (chr == '$'){
-                        break;
+            }
+            this->_cpu->consoleOutput(chr);
+            this->bdosResult(chr);
+            break;
+        }
+        case 0x02:
+            // Console output
+            this->_cpu->consoleOutput(this->_cpu->registers.e);
+            break;
+        case 0x06:
+            // Direct console I/O
+            switch (this->_cpu->registers.e){
+                case 0xff: {
+                    int chr = (console != nullptr) ? console->read(this->_cpu->tick) : -1;
+                    this->bdosResult(chr < 0 ? 0 : chr);
+                    break;
+                }
+                case 0xfe:
+                    this->bdosResult((console != nullptr && console->ready(this->_cpu->tick)) ? 0xff : 0);
+                    break;
+                case 0xfd: {
+                    int chr = this->consoleInput();
+                    if (chr >= 0){
+                        this->bdosResult(chr);
                     }
-                    printf("%c", chr);
-                } while(true);
-                printf("\n");
-                break;
+                    break;
+                }
+                default:
+                    this->_cpu->consoleOutput(this->_cpu->registers.e);
+                    break;
             }
-            default:
+            break;
+        case 0x09: {
+            // Output string
+            uint8_t chr;
+            do {
+                chr = Mcycle::m2(this->_cpu, this->_cpu->registers.de());
+                this->_cpu->registers.de(this->_cpu->registers.de() + 1);
+                if (chr == '$'){
+                    break;
+                }
+                this->_cpu->consoleOutput(chr);
+            } while(true);
+            break;
+        }
+        case 0x0a:
+            // Read console buffer
+            this->readConsoleBuffer();
+            break;
+        case 0x0b:
+            // Get console status
+            this->bdosResult((console != nullptr && console->ready(this->_cpu->tick)) ? 0xff : 0);
+            break;
+        default:
+            // Disk functions
+            if (this->_cpu->bdos != nullptr && this->_cpu->bdos->call(this->_cpu)){
                 break;
+            }
+            // The caller's return address is on the stack
+            fprintf(stderr, "CP/M BDOS function %02x is not supported (pc:%04x)\n",
+                    this->_cpu->registers.c,
+                    this->_cpu->memory(this->_cpu->special_registers.sp) +
+                    (this->_cpu->memory(this->_cpu->special_registers.sp + 1) << 8));
+            break;
+    }
+    return ! this->bdos_wait;
+}
+
+void OpCode::bdosResult(uint16_t value){
+    // A = L, B = H
+    this->_cpu->registers.hl(value);
+    this->_cpu->registers.a = value & 0xff;
+    this->_cpu->registers.b = value >> 8;
+}
+
+int OpCode::consoleInput(){
+    Console* console = this->_cpu->console;
+    if (console == nullptr || console->closed()){
+        // End of input
+        return 0x1a;
+    }
+    int chr = console->read(this->_cpu->tick);
+    if (chr < 0){
+        this->waitConsole();
+    }
+    return chr;
+}
+
+void OpCode::waitConsole(){
+    // The call runs again on the next step. Interrupts are still taken meanwhile.
+    this->bdos_wait = true;
+    this->_cpu->console->wait(1);
+}
+
+void OpCode::readConsoleBuffer(){
+    Console* console = this->_cpu->console;
+    uint16_t buffer = this->_cpu->registers.de();
+    if (console != nullptr && ! console->lineReady(this->_cpu->tick)){
+        this->waitConsole();
+        return;
+    }
+    uint8_t max = Mcycle::m2(this->_cpu, buffer);
+    uint8_t count = 0;
+    while (console != nullptr){
+        int chr = console->read(this->_cpu->tick);
+        if (chr < 0 || chr == '\r'){
+            break;
+        }
+        if (chr == 0x08 || chr == 0x7f){
+            // Backspace
+            if (count > 0){
+                count--;
+                this->_cpu->consoleOutput(0x08);
+                this->_cpu->consoleOutput(' ');
+                this->_cpu->consoleOutput(0x08);
+            }
+            continue;
+        }
+        if (count < max){
+            Mcycle::m3(this->_cpu, buffer + 2 + count++, chr);
+            this->_cpu->consoleOutput(chr);
         }
     }
+    Mcycle::m3(this->_cpu, buffer + 1, count);
+    this->_cpu->consoleOutput('\r');
 }
 
 uint8_t OpCode::count1(uint8_t data){
@@ -8,30 +8,6 @@ uint16_t Registers::af() const{
     return (this->a << 8) + this->f();
 }
 
-void Registers::bc(uint16_t value){
-    this->b = (uint8_t)(value >> 8);
-    this->c = (uint8_t)(value & 0xff);
-}
-uint16_t Registers::bc() const{
-    return (this->b << 8) + this->c;
-}
-
-void Registers::de(uint16_t value){
-    this->d = (uint8_t)(value >> 8);
-    this->e = (uint8_t)(value & 0xff);
-}
-uint16_t Registers::de() const{
-    return (this->d << 8) + this->e;
-}
-
-void Registers::hl(uint16_t value){
-    this->h = (uint8_t)(value >> 8);
-    this->l = (uint8_t)(value & 0xff);
-}
-uint16_t Registers::hl() const{
-    return (this->h << 8) + this->l;
-}
-
 void Registers::f(uint8_t value){
     this->FC_Carry =            ((value & 0b00000001) > 0);
     this->FN_Subtract =         ((value & 0b00000010) > 0);
@@ -2,16 +2,26 @@
 #define Z80EMU_REGISTERS_HPP
 #include <cstdint>
 
+// Register pairs share storage with their halves, low byte first, so bc() and b are both a
+// single load or store. That layout is the host's only on little-endian machines.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Register pairs need a little-endian host");
+
 class Registers
 {
 public:
     uint8_t a = 0;
-    uint8_t b = 0;
-    uint8_t c = 0;
-    uint8_t d = 0;
-    uint8_t e = 0;
-    uint8_t h = 0;
-    uint8_t l = 0;
+    union {
+        uint16_t bc_pair = 0;
+        struct { uint8_t c; uint8_t b; };
+    };
+    union {
+        uint16_t de_pair = 0;
+        struct { uint8_t e; uint8_t d; };
+    };
+    union {
+        uint16_t hl_pair = 0;
+        struct { uint8_t l; uint8_t h; };
+    };
 //    uint16_t ix = 0;
 //    uint16_t iy = 0;
 
@@ -37,12 +47,12 @@ public:
 
     void af(uint16_t value);
     [[nodiscard]] uint16_t af() const;
-    void bc(uint16_t value);
-    [[nodiscard]] uint16_t bc() const;
-    void de(uint16_t value);
-    [[nodiscard]] uint16_t de() const;
-    void hl(uint16_t value);
-    [[nodiscard]] uint16_t hl() const;
+    void bc(uint16_t value){ this->bc_pair = value; }
+    [[nodiscard]] uint16_t bc() const{ return this->bc_pair; }
+    void de(uint16_t value){ this->de_pair = value; }
+    [[nodiscard]] uint16_t de() const{ return this->de_pair; }
+    void hl(uint16_t value){ this->hl_pair = value; }
+    [[nodiscard]] uint16_t hl() const{ return this->hl_pair; }
 
     uint8_t carry_by_val();
 
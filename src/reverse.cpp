@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <stdexcept>
+#include "reverse.hpp"
+#include "bdos.hpp"
+#include "cpu.hpp"
+#include "snapshot.hpp"
+
+// Silences the side effects of re-executed instructions while in scope.
+// Breakpoints stay armed only for steps the debugger asked for.
+class Mute {
+public:
+    explicit Mute(Cpu* _cpu, bool keep_debug = false) : cpu(_cpu) {
+        this->console_output = this->cpu->console_output;
+        this->log_sink = this->cpu->log_sink;
+        this->metrics_publisher = this->cpu->metrics_publisher;
+        this->debug_active = this->cpu->debug_active;
+        if (this->cpu->bdos != nullptr){
+            this->bdos_muted = this->cpu->bdos->muted;
+            this->cpu->bdos->muted = true;
+        }
+        this->cpu->console_output = [](uint8_t){};
+        this->cpu->log_sink = nullptr;
+        this->cpu->metrics_publisher = nullptr;
+        this->cpu->debug_active = keep_debug && this->debug_active;
+    }
+    ~Mute(){
+        this->cpu->console_output = this->console_output;
+        this->cpu->log_sink = this->log_sink;
+        this->cpu->metrics_publisher = this->metrics_publisher;
+        this->cpu->debug_active = this->debug_active;
+        if (this->cpu->bdos != nullptr){
+            this->cpu->bdos->muted = this->bdos_muted;
+        }
+    }
+
+private:
+    Cpu* cpu;
+    std::function<void(uint8_t)> console_output;
+    std::ostream* log_sink;
+    MetricsPublisher* metrics_publisher;
+    bool debug_active;
+    bool bdos_muted = false;
+};
+
+ReverseExecution::ReverseExecution(Cpu* _cpu, double _replay_seconds, uint64_t _history_bytes)
+        : cpu(_cpu), replay_seconds(_replay_seconds), history_bytes(_history_bytes) {
+    this->horizon = this->position();
+    this->checkpoint();
+}
+
+uint64_t ReverseExecution::position(){
+    return this->cpu->metrics.instructions;
+}
+
+uint64_t ReverseExecution::start(){
+    return this->checkpoints.front().instructions;
+}
+
+void ReverseExecution::step(){
+    if (this->cpu->stopped){
+        return;
+    }
+    if (this->position() < this->horizon){
+        Mute mute(this->cpu, true);
+        this->cpu->step();
+        return;
+    }
+    if (this->position() - this->checkpoints.back().instructions >= this->checkpoint_spacing){
+        this->checkpoint();
+    }
+    this->cpu->step();
+    this->horizon = this->position();
+    this->measure();
+}
+
+bool ReverseExecution::reverseStep(){
+    if (this->position() <= this->start()){
+        return false;
+    }
+    this->seek(this->position() - 1);
+    return true;
+}
+
+bool ReverseExecution::reverseContinue(const std::function<bool(Cpu*)>& stop){
+    uint64_t target = this->position();
+    uint64_t end = target;
+    size_t index = this->nearest(target > 0 ? target - 1 : 0);
+
+    while (true){
+        bool hit = false;
+        uint64_t found = 0;
+        this->restore(index);
+        {
+            Mute mute(this->cpu);
+            while (this->position() < end && ! this->cpu->stopped){
+                if (stop(this->cpu)){
+                    hit = true;
+                    found = this->position();
+                }
+                this->cpu->step();
+            }
+        }
+        if (hit){
+            this->seek(found);
+            return true;
+        }
+        if (index == 0){
+            break;
+        }
+        end = this->checkpoints[index].instructions;
+        index--;
+    }
+    this->seek(target);
+    return false;
+}
+
+void ReverseExecution::seek(uint64_t target){
+    if (target < this->start() || target > this->horizon){
+        throw std::runtime_error("Position outside the recorded history");
+    }
+    size_t index = this->nearest(target);
+    // Going forward within the same interval needs no restore
+    uint64_t current = this->position();
+    if (current > target || current < this->checkpoints[index].instructions){
+        this->restore(index);
+    }
+    this->replay(target);
+}
+
+void ReverseExecution::invalidate(){
+    uint64_t current = this->position();
+    while (! this->checkpoints.empty() && this->checkpoints.back().instructions >= current){
+        this->used_bytes -= this->checkpoints.back().image.size();
+        this->checkpoints.pop_back();
+    }
+    this->horizon = current;
+    this->since_keyframe = KEYFRAME_INTERVAL;
+    this->checkpoint();
+}
+
+void ReverseExecution::checkpoint(){
+    bool keyframe = this->checkpoints.empty() || this->since_keyframe >= KEYFRAME_INTERVAL;
+    if (! keyframe){
+        // After going back and forth the dirty pages date from an older checkpoint.
+        // They are a superset of the pages changed since the latest one, so the delta still holds.
+        this->cpu->checkpoint_tick = this->checkpoints.back().tick;
+    }
+    this->checkpoints.push_back({this->position(), this->cpu->tick, keyframe, Snapshot::capture(this->cpu, !keyframe)});
+    this->used_bytes += this->checkpoints.back().image.size();
+    this->since_keyframe = keyframe ? 1 : this->since_keyframe + 1;
+
+    // Forget the oldest keyframe and its deltas when over budget
+    while (this->used_bytes > this->history_bytes){
+        auto next = std::find_if(this->checkpoints.begin() + 1, this->checkpoints.end(),
+                                 [](const Checkpoint& c){ return c.keyframe; });
+        if (next == this->checkpoints.end()){
+            break;
+        }
+        for (auto it = this->checkpoints.begin(); it != next; ++it){
+            this->used_bytes -= it->image.size();
+        }
+        this->checkpoints.erase(this->checkpoints.begin(), next);
+    }
+}
+
+void ReverseExecution::measure(){
+    auto now = std::chrono::steady_clock::now();
+    if (this->batch_count++ == 0){
+        this->batch_start = now;
+        return;
+    }
+    if (this->batch_count < BATCH){
+        return;
+    }
+    this->batch_count = 0;
+    double seconds = std::chrono::duration<double>(now - this->batch_start).count();
+    if (seconds <= 0 || seconds > this->replay_seconds * 10){
+        // Stepped interactively. This says nothing about the execution speed.
+        return;
+    }
+    double rate = BATCH / seconds;
+    this->instructions_per_sec = (this->instructions_per_sec == 0) ? rate : this->instructions_per_sec * 0.75 + rate * 0.25;
+    this->checkpoint_spacing = std::clamp<uint64_t>((uint64_t)(this->instructions_per_sec * this->replay_seconds),
+                                                    (uint64_t)MIN_SPACING, (uint64_t)MAX_SPACING);
+}
+
+void ReverseExecution::restore(size_t index){
+    size_t keyframe = index;
+    while (! this->checkpoints[keyframe].keyframe){
+        keyframe--;
+    }
+    for (size_t i = keyframe; i <= index; i++){
+        const std::vector<uint8_t>& image = this->checkpoints[i].image;
+        Snapshot::restore(this->cpu, image.data(), image.size());
+    }
+}
+
+size_t ReverseExecution::nearest(uint64_t target){
+    auto it = std::upper_bound(this->checkpoints.begin(), this->checkpoints.end(), target,
+                               [](uint64_t value, const Checkpoint& c){ return value < c.instructions; });
+    return (it == this->checkpoints.begin()) ? 0 : (it - this->checkpoints.begin()) - 1;
+}
+
+void ReverseExecution::replay(uint64_t target){
+    Mute mute(this->cpu);
+    while (this->position() < target && ! this->cpu->stopped){
+        this->cpu->step();
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef Z80EMU_REVERSE_HPP
+#define Z80EMU_REVERSE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Cpu;
+
+// Reverse execution for a deterministic machine (simulated bus, host memory).
+//
+// Forward steps record checkpoints as snapshot deltas. Going back restores the nearest
+// checkpoint and re-executes up to the target instruction count. The spacing between
+// checkpoints follows the measured execution speed, so no backward step re-executes more than
+// about replay_seconds worth of instructions. Console and trace output are muted while history
+// is re-executed.
+class ReverseExecution {
+public:
+    static constexpr double DEFAULT_REPLAY_SECONDS = 0.05;
+    static const uint64_t DEFAULT_HISTORY_BYTES = 256ull * 1024 * 1024;
+    static const uint64_t MIN_SPACING = 1000;
+    static const uint64_t MAX_SPACING = 10 * 1000 * 1000;
+    // Every KEYFRAME_INTERVAL-th checkpoint is a full snapshot, so a restore applies few deltas
+    static const uint32_t KEYFRAME_INTERVAL = 32;
+
+    explicit ReverseExecution(Cpu* cpu, double replay_seconds = DEFAULT_REPLAY_SECONDS,
+                              uint64_t history_bytes = DEFAULT_HISTORY_BYTES);
+
+    // Instructions executed so far. This is the position in history.
+    uint64_t position();
+    // Oldest position that can still be reached
+    uint64_t start();
+
+    void step();
+    bool reverseStep();
+    // Goes back to the latest earlier position whose state satisfies stop.
+    // Stays put and returns false when there is none in the recorded history.
+    bool reverseContinue(const std::function<bool(Cpu*)>& stop);
+    // Moves to any position between start() and the furthest point executed.
+    void seek(uint64_t position);
+    // Call after the machine was changed from outside (e.g. a debugger wrote memory).
+    // History after the current position no longer follows from it and is dropped.
+    void invalidate();
+
+    uint64_t spacing(){ return this->checkpoint_spacing; }
+    size_t checkpointCount(){ return this->checkpoints.size(); }
+
+private:
+    struct Checkpoint {
+        uint64_t instructions;
+        uint64_t tick;
+        bool keyframe;
+        std::vector<uint8_t> image;
+    };
+
+    static const uint32_t BATCH = 4096;
+
+    Cpu* cpu;
+    double replay_seconds;
+    uint64_t history_bytes;
+    uint64_t used_bytes = 0;
+    std::vector<Checkpoint> checkpoints;
+    // Furthest position executed. Steps before it re-execute history.
+    uint64_t horizon = 0;
+    uint64_t checkpoint_spacing = MIN_SPACING;
+    uint32_t since_keyframe = 0;
+
+    double instructions_per_sec = 0;
+    uint32_t batch_count = 0;
+    std::chrono::steady_clock::time_point batch_start;
+
+    void checkpoint();
+    void measure();
+    void restore(size_t index);
+    size_t nearest(uint64_t position);
+    void replay(uint64_t position);
+};
+
+#endif //Z80EMU_REVERSE_HPP
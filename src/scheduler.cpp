@@ -0,0 +1,34 @@
+#include <algorithm>
+#include "scheduler.hpp"
+
+void Scheduler::post(uint64_t when, Handler handler){
+    this->heap.push_back({when, this->sequence++, std::move(handler)});
+    std::push_heap(this->heap.begin(), this->heap.end(), later);
+    this->next = this->heap.front().when;
+}
+
+void Scheduler::run(uint64_t now){
+    while (! this->heap.empty() && this->heap.front().when <= now){
+        std::pop_heap(this->heap.begin(), this->heap.end(), later);
+        Event event = std::move(this->heap.back());
+        this->heap.pop_back();
+        // The handler may post, so the heap is consistent before it runs
+        this->next = this->heap.empty() ? NEVER : this->heap.front().when;
+        event.handler(now);
+    }
+    this->next = this->heap.empty() ? NEVER : this->heap.front().when;
+}
+
+void Scheduler::rebase(uint64_t from, uint64_t to){
+    for (Event& event : this->heap){
+        event.when = (event.when > from) ? to + (event.when - from) : to;
+    }
+    // Overdue events now share a T-state, where the posting order decides
+    std::make_heap(this->heap.begin(), this->heap.end(), later);
+    this->next = this->heap.empty() ? NEVER : this->heap.front().when;
+}
+
+void Scheduler::clear(){
+    this->heap.clear();
+    this->next = NEVER;
+}
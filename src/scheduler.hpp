@@ -0,0 +1,43 @@
+#ifndef Z80EMU_SCHEDULER_HPP
+#define Z80EMU_SCHEDULER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Future events of emulated devices (timer ticks, a received character, ...) keyed by T-state.
+// Cpu::step compares tick with deadline() once per instruction and runs what is due, so devices
+// cost nothing between their events. A binary heap keeps post and run at O(log n).
+class Scheduler {
+public:
+    using Handler = std::function<void(uint64_t now)>;
+    static const uint64_t NEVER = UINT64_MAX;
+
+    // Runs handler once tick reaches when. Events due at the same T-state run in posting order.
+    void post(uint64_t when, Handler handler);
+    // Runs everything due at now, including events the handlers post for now or earlier
+    void run(uint64_t now);
+    // Moves pending events with the clock, keeping their distance from it. For snapshot restore.
+    void rebase(uint64_t from, uint64_t to);
+    void clear();
+
+    uint64_t deadline() const{ return this->next; }
+    size_t pending() const{ return this->heap.size(); }
+
+private:
+    struct Event {
+        uint64_t when;
+        uint64_t sequence;
+        Handler handler;
+    };
+    // Orders the heap with the earliest event in front
+    static bool later(const Event& a, const Event& b){
+        return a.when != b.when ? a.when > b.when : a.sequence > b.sequence;
+    }
+
+    std::vector<Event> heap;
+    uint64_t next = NEVER;
+    uint64_t sequence = 0;
+};
+
+#endif //Z80EMU_SCHEDULER_HPP
@@ -0,0 +1,266 @@
+#include "sio.hpp"
+#include "console.hpp"
+#include "cpu.hpp"
+
+// Status codes put in vector bits 3-1
+static const uint8_t CODE_TX_B = 0;
+static const uint8_t CODE_RX_B = 2;
+static const uint8_t CODE_NONE = 3;
+static const uint8_t CODE_TX_A = 4;
+static const uint8_t CODE_RX_A = 6;
+
+Sio::Sio(Console* channel_a, Console* channel_b){
+    this->channels[0].host = channel_a;
+    this->channels[1].host = channel_b;
+    for (Channel& channel : this->channels){
+        if (channel.host != nullptr){
+            channel.host->translate_newlines = false;
+        }
+    }
+    this->reset();
+}
+
+void Sio::attach(Cpu* _cpu, uint8_t _base){
+    this->cpu = _cpu;
+    this->base = _base;
+    _cpu->io_map.attach(_base, 4, this);
+    _cpu->io_map.addInterruptSource(this);
+}
+
+void Sio::setBaud(uint32_t baud, uint32_t clock_hz){
+    // Start bit, 8 data bits and a stop bit
+    this->char_tstates = (baud == 0) ? 0 : (uint64_t)clock_hz * 10 / baud;
+}
+
+void Sio::reset(){
+    this->resetChannel(&this->channels[0]);
+    this->resetChannel(&this->channels[1]);
+    // The vector survives a channel reset but not a hardware reset
+    this->channels[1].wr[2] = 0;
+    this->in_service = false;
+}
+
+void Sio::refresh(uint64_t now){
+    if (this->cpu != nullptr){
+        this->cpu->io_map.updateInterrupt(now);
+    }
+}
+
+void Sio::refreshAt(uint64_t when){
+    if (this->cpu != nullptr){
+        this->cpu->scheduler.post(when, [this](uint64_t now){ this->refresh(now); });
+    }
+}
+
+void Sio::schedulePoll(uint64_t now){
+    // Input arrives from the host at any time. Look for it while a receive interrupt could fire.
+    bool receiving = false;
+    for (Channel& channel : this->channels){
+        receiving |= ((channel.wr[1] >> 3) & 0x03) != 0 && (channel.wr[3] & 0x01) && channel.host != nullptr;
+    }
+    if (! receiving || this->poll_posted || this->cpu == nullptr){
+        return;
+    }
+    this->poll_posted = true;
+    this->cpu->scheduler.post(now + Console::POLL_INTERVAL, [this](uint64_t at){
+        this->poll_posted = false;
+        this->refresh(at);
+        this->schedulePoll(at);
+    });
+}
+
+void Sio::resetChannel(Channel* channel){
+    uint8_t vector = channel->wr[2];
+    for (uint8_t& wr : channel->wr){
+        wr = 0;
+    }
+    channel->wr[2] = vector;
+    channel->pointer = 0;
+    channel->rx_first_armed = false;
+    channel->tx_busy = false;
+    channel->tx_int_pending = false;
+}
+
+void Sio::update(Channel* channel, uint64_t now){
+    if (channel->tx_busy && now >= channel->tx_empty_at){
+        channel->tx_busy = false;
+        channel->tx_int_pending = true;
+    }
+}
+
+bool Sio::rxAvailable(Channel* channel, uint64_t now){
+    // WR3 bit 0: receiver enable
+    if (!(channel->wr[3] & 0x01) || channel->host == nullptr || now < channel->rx_ready_at){
+        return false;
+    }
+    return channel->host->ready(now);
+}
+
+bool Sio::rxInterrupt(Channel* channel, uint64_t now){
+    // WR1 bits 4-3: 0 disabled, 1 on first character, 2 and 3 on every character
+    uint8_t mode = (channel->wr[1] >> 3) & 0x03;
+    if (mode == 0 || (mode == 1 && ! channel->rx_first_armed)){
+        return false;
+    }
+    return this->rxAvailable(channel, now);
+}
+
+bool Sio::txInterrupt(Channel* channel, uint64_t now){
+    // WR1 bit 1: transmit interrupt enable
+    if (!(channel->wr[1] & 0x02)){
+        return false;
+    }
+    this->update(channel, now);
+    return channel->tx_int_pending;
+}
+
+uint8_t Sio::interruptCause(uint64_t now){
+    if (this->rxInterrupt(&this->channels[0], now)){
+        return CODE_RX_A;
+    }
+    if (this->txInterrupt(&this->channels[0], now)){
+        return CODE_TX_A;
+    }
+    if (this->rxInterrupt(&this->channels[1], now)){
+        return CODE_RX_B;
+    }
+    if (this->txInterrupt(&this->channels[1], now)){
+        return CODE_TX_B;
+    }
+    return CAUSE_NONE;
+}
+
+uint8_t Sio::vector(uint8_t cause){
+    const Channel& b = this->channels[1];
+    // WR1 bit 2 of channel B: status affects vector
+    if (!(b.wr[1] & 0x04)){
+        return b.wr[2];
+    }
+    uint8_t code = (cause == CAUSE_NONE) ? CODE_NONE : cause;
+    return (b.wr[2] & 0xf1) | (code << 1);
+}
+
+bool Sio::intPending(uint64_t now){
+    return ! this->in_service && this->interruptCause(now) != CAUSE_NONE;
+}
+
+uint8_t Sio::intAcknowledge(uint64_t now){
+    uint8_t cause = this->interruptCause(now);
+    if (cause == CODE_RX_A || cause == CODE_RX_B){
+        this->channels[cause == CODE_RX_A ? 0 : 1].rx_first_armed = false;
+    }
+    this->in_service = true;
+    return this->vector(cause);
+}
+
+uint8_t Sio::ioRead(Cpu* cpu, uint16_t port){
+    uint8_t offset = (uint8_t)(port - this->base) & 0x03;
+    int index = offset >> 1;
+    Channel* channel = &this->channels[index];
+    if (offset == PORT_CONTROL_A || offset == PORT_CONTROL_B){
+        return this->readControl(index, cpu->tick);
+    }
+    if (! this->rxAvailable(channel, cpu->tick)){
+        return 0;
+    }
+    int data = channel->host->read(cpu->tick);
+    channel->rx_ready_at = cpu->tick + this->char_tstates;
+    this->refresh(cpu->tick);
+    if (this->char_tstates > 0){
+        this->refreshAt(channel->rx_ready_at);
+    }
+    return (data < 0) ? 0 : data;
+}
+
+void Sio::ioWrite(Cpu* cpu, uint16_t port, uint8_t data){
+    uint8_t offset = (uint8_t)(port - this->base) & 0x03;
+    int index = offset >> 1;
+    Channel* channel = &this->channels[index];
+    if (offset == PORT_CONTROL_A || offset == PORT_CONTROL_B){
+        this->writeControl(index, data);
+        this->refresh(cpu->tick);
+        this->schedulePoll(cpu->tick);
+        return;
+    }
+    if (channel->host != nullptr){
+        channel->host->write(data, cpu->tick);
+    }
+    channel->tx_busy = true;
+    channel->tx_int_pending = false;
+    channel->tx_empty_at = cpu->tick + this->char_tstates;
+    this->update(channel, cpu->tick);
+    this->refresh(cpu->tick);
+    if (this->char_tstates > 0){
+        this->refreshAt(channel->tx_empty_at);
+    }
+}
+
+uint8_t Sio::readControl(int index, uint64_t now){
+    Channel* channel = &this->channels[index];
+    uint8_t reg = channel->pointer;
+    channel->pointer = 0;
+    this->update(channel, now);
+    switch (reg){
+        case 0: {
+            uint8_t rr0 = RR0_DCD | RR0_CTS;
+            if (this->rxAvailable(channel, now)){
+                rr0 |= RR0_RX_AVAILABLE;
+            }
+            if (! channel->tx_busy){
+                rr0 |= RR0_TX_EMPTY;
+            }
+            // Interrupt pending is only reported by channel A
+            if (index == 0 && this->intPending(now)){
+                rr0 |= RR0_INT_PENDING;
+            }
+            return rr0;
+        }
+        case 1:
+            return channel->tx_busy ? 0 : RR1_ALL_SENT;
+        case 2:
+            // Channel B only. Shows the vector the next acknowledge would return.
+            return (index == 1) ? this->vector(this->interruptCause(now)) : 0;
+        default:
+            return 0;
+    }
+}
+
+void Sio::writeControl(int index, uint8_t data){
+    Channel* channel = &this->channels[index];
+    uint8_t reg = channel->pointer;
+    channel->pointer = 0;
+    if (reg != 0){
+        // WR2 exists in channel B only. Writes through channel A land there too.
+        if (reg == 2){
+            this->channels[1].wr[2] = data;
+            return;
+        }
+        channel->wr[reg] = data;
+        // Selecting receive interrupt on first character arms it
+        if (reg == 1 && ((data >> 3) & 0x03) == 1){
+            channel->rx_first_armed = true;
+        }
+        return;
+    }
+    channel->wr[0] = data;
+    channel->pointer = data & 0x07;
+    switch ((data >> 3) & 0x07){
+        case 3: // Channel reset
+            this->resetChannel(channel);
+            break;
+        case 4: // Enable interrupt on next received character
+            channel->rx_first_armed = true;
+            break;
+        case 5: // Reset transmit interrupt pending
+            channel->tx_int_pending = false;
+            break;
+        case 7: // Return from interrupt, channel A only
+            if (index == 0){
+                this->in_service = false;
+            }
+            break;
+        default:
+            // Null, send abort, reset external/status interrupts, error reset: nothing to do here
+            break;
+    }
+}
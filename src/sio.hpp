@@ -0,0 +1,91 @@
+#ifndef Z80EMU_SIO_HPP
+#define Z80EMU_SIO_HPP
+
+#include <cstdint>
+#include "io.hpp"
+
+class Console;
+class Cpu;
+
+// Z80 SIO/2 with two asynchronous channels, each backed by a Console (stdio, a pty or nothing).
+//
+// Characters move through the Console ring buffers at host speed, or paced to a baud rate so a
+// program sees the timing of a real line. Interrupts use the SIO vector (WR2 of channel B),
+// optionally modified by status, and take part in the daisy chain of the IoMap. The request is
+// re-evaluated on register access and from scheduler events (end of a paced character, a receive
+// poll every Console::POLL_INTERVAL T-states while receive interrupts are on), not per instruction.
+// Modem lines are always asserted and external/status interrupts are never raised.
+// Registers follow the Zilog Z80 SIO technical manual.
+class Sio : public IoDevice, public InterruptSource {
+public:
+    // Port offsets from the base, as on most CP/M boards
+    static const uint8_t PORT_CONTROL_A = 0;
+    static const uint8_t PORT_DATA_A = 1;
+    static const uint8_t PORT_CONTROL_B = 2;
+    static const uint8_t PORT_DATA_B = 3;
+
+    // RR0
+    static const uint8_t RR0_RX_AVAILABLE = 0x01;
+    static const uint8_t RR0_INT_PENDING = 0x02;
+    static const uint8_t RR0_TX_EMPTY = 0x04;
+    static const uint8_t RR0_DCD = 0x08;
+    static const uint8_t RR0_CTS = 0x20;
+    // RR1
+    static const uint8_t RR1_ALL_SENT = 0x01;
+
+    // Either console may be null: the channel then never receives and drops what it sends.
+    explicit Sio(Console* channel_a, Console* channel_b = nullptr);
+
+    // Claims the four ports at base of cpu's IoMap and joins its daisy chain
+    void attach(Cpu* cpu, uint8_t base);
+    // Characters take 10 bit times of the line. 0 runs at host speed.
+    void setBaud(uint32_t baud, uint32_t clock_hz);
+    void reset();
+
+    uint8_t ioRead(Cpu* cpu, uint16_t port) override;
+    void ioWrite(Cpu* cpu, uint16_t port, uint8_t data) override;
+
+    bool intPending(uint64_t now) override;
+    uint8_t intAcknowledge(uint64_t now) override;
+    bool inService() override{ return this->in_service; }
+    void intReturn() override{ this->in_service = false; }
+
+private:
+    // Interrupt causes, highest priority first. The values are bits 3-1 of a status vector.
+    static const uint8_t CAUSE_NONE = 0xff;
+
+    struct Channel {
+        Console* host = nullptr;
+        uint8_t wr[8] = {};
+        uint8_t pointer = 0;
+        // Receive interrupt on first character: armed until it fires
+        bool rx_first_armed = false;
+        bool tx_busy = false;
+        bool tx_int_pending = false;
+        uint64_t rx_ready_at = 0;
+        uint64_t tx_empty_at = 0;
+    };
+
+    Channel channels[2];
+    Cpu* cpu = nullptr;
+    uint8_t base = 0;
+    uint64_t char_tstates = 0;
+    bool in_service = false;
+    bool poll_posted = false;
+
+    void resetChannel(Channel* channel);
+    void update(Channel* channel, uint64_t now);
+    bool rxAvailable(Channel* channel, uint64_t now);
+    bool rxInterrupt(Channel* channel, uint64_t now);
+    bool txInterrupt(Channel* channel, uint64_t now);
+    uint8_t interruptCause(uint64_t now);
+    uint8_t vector(uint8_t cause);
+    uint8_t readControl(int index, uint64_t now);
+    void writeControl(int index, uint8_t data);
+    // Tells the CPU the request may have changed
+    void refresh(uint64_t now);
+    void refreshAt(uint64_t when);
+    void schedulePoll(uint64_t now);
+};
+
+#endif //Z80EMU_SIO_HPP
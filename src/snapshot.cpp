@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.hpp"
+#include "bdos.hpp"
+#include "cpu.hpp"
+#include "mmu.hpp"
+
+static const char MAGIC[8] = {'Z', '8', '0', 'S', 'N', 'A', 'P', '\0'};
+static const char* DEVICES_ERROR = "Snapshots do not hold the state of the attached devices";
+
+static_assert(sizeof(Snapshot::Header) <= Snapshot::PAGE_SIZE, "Snapshot header must fit in one page");
+static_assert(sizeof(PageBitmap) * 8 * Snapshot::MEMORY_PAGE_SIZE == 0x10000, "Page bitmap must cover 64KB");
+
+static uint64_t align(uint64_t offset, uint64_t alignment){
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static void saveRegisters(Cpu* cpu, Snapshot::Registers* regs){
+    regs->af = cpu->registers.af();
+    regs->bc = cpu->registers.bc();
+    regs->de = cpu->registers.de();
+    regs->hl = cpu->registers.hl();
+    regs->af_alt = cpu->registers_alternate.af();
+    regs->bc_alt = cpu->registers_alternate.bc();
+    regs->de_alt = cpu->registers_alternate.de();
+    regs->hl_alt = cpu->registers_alternate.hl();
+    regs->ix = cpu->special_registers.ix;
+    regs->iy = cpu->special_registers.iy;
+    regs->sp = cpu->special_registers.sp;
+    regs->pc = cpu->special_registers.pc;
+    regs->i = cpu->special_registers.i;
+    regs->r = cpu->special_registers.r;
+    regs->iff1 = cpu->iff1;
+    regs->iff2 = cpu->iff2;
+    regs->interrupt_mode = cpu->interrupt_mode;
+    regs->halt = cpu->halt;
+    regs->waiting_ei = cpu->waitingEI;
+    regs->waiting_di = cpu->waitingDI;
+    regs->executing = cpu->executing;
+    regs->stopped = cpu->stopped;
+    regs->enable_virtual_memory = cpu->enable_virtual_memory;
+    regs->emulate_cpm_bdos_call = cpu->emulate_cpm_bdos_call;
+    regs->tick = cpu->tick;
+    regs->instructions = cpu->metrics.instructions;
+}
+
+static void loadRegisters(Cpu* cpu, const Snapshot::Registers* regs){
+    cpu->registers.af(regs->af);
+    cpu->registers.bc(regs->bc);
+    cpu->registers.de(regs->de);
+    cpu->registers.hl(regs->hl);
+    cpu->registers_alternate.af(regs->af_alt);
+    cpu->registers_alternate.bc(regs->bc_alt);
+    cpu->registers_alternate.de(regs->de_alt);
+    cpu->registers_alternate.hl(regs->hl_alt);
+    cpu->special_registers.ix = regs->ix;
+    cpu->special_registers.iy = regs->iy;
+    cpu->special_registers.sp = regs->sp;
+    cpu->special_registers.pc = regs->pc;
+    cpu->special_registers.i = regs->i;
+    cpu->special_registers.r = regs->r;
+    cpu->iff1 = regs->iff1;
+    cpu->iff2 = regs->iff2;
+    cpu->interrupt_mode = regs->interrupt_mode;
+    cpu->halt = regs->halt;
+    cpu->waitingEI = regs->waiting_ei;
+    cpu->waitingDI = regs->waiting_di;
+    cpu->executing = regs->executing;
+    cpu->stopped = regs->stopped;
+    cpu->enable_virtual_memory = regs->enable_virtual_memory;
+    cpu->emulate_cpm_bdos_call = regs->emulate_cpm_bdos_call;
+    // Pending events keep their distance from the clock. None belong to devices: those are
+    // refused, since their state is not in the image.
+    cpu->scheduler.rebase(cpu->tick, regs->tick);
+    cpu->tick = regs->tick;
+    cpu->metrics.instructions = regs->instructions;
+}
+
+std::vector<uint8_t> Snapshot::capture(Cpu* cpu, bool delta){
+    if (! cpu->io_map.snapshotSafe()){
+        throw std::runtime_error(DEVICES_ERROR);
+    }
+    // Full images are page aligned so they can be mapped. Deltas are kept small.
+    uint64_t alignment = delta ? 8 : PAGE_SIZE;
+
+    std::vector<uint8_t> memory_pages;
+    if (cpu->mmu != nullptr){
+        cpu->mmu->saveState(memory_pages, delta);
+    } else if (delta){
+        savePages(cpu->virtual_memory.data(), &cpu->dirty_pages, memory_pages);
+    }
+    std::vector<uint8_t> bus_state;
+    cpu->bus->saveState(bus_state, delta);
+    cpu->dirty_pages.fill(0);
+    std::vector<uint8_t> bdos_state;
+    if (cpu->bdos != nullptr){
+        cpu->bdos->saveState(bdos_state);
+    }
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = delta ? FLAG_DELTA : 0;
+    header.base_tick = cpu->checkpoint_tick;
+    saveRegisters(cpu, &header.registers);
+    cpu->checkpoint_tick = cpu->tick;
+
+    const uint8_t* data[MAX_SECTIONS] = {};
+    uint64_t offset = align(sizeof(Header), alignment);
+    if (cpu->mmu != nullptr){
+        data[header.section_count] = memory_pages.data();
+        header.sections[header.section_count++] = {SECTION_BANKED_MEMORY, 0, offset, memory_pages.size()};
+        offset = align(offset + memory_pages.size(), alignment);
+    } else if (delta){
+        data[header.section_count] = memory_pages.data();
+        header.sections[header.section_count++] = {SECTION_MEMORY_PAGES, 0, offset, memory_pages.size()};
+        offset = align(offset + memory_pages.size(), alignment);
+    } else {
+        data[header.section_count] = cpu->virtual_memory.data();
+        header.sections[header.section_count++] = {SECTION_MEMORY, 0, offset, cpu->virtual_memory.size()};
+        offset = align(offset + cpu->virtual_memory.size(), alignment);
+    }
+    if (! bus_state.empty()){
+        data[header.section_count] = bus_state.data();
+        header.sections[header.section_count++] = {SECTION_BUS, 0, offset, bus_state.size()};
+        offset = align(offset + bus_state.size(), alignment);
+    }
+    if (! bdos_state.empty()){
+        data[header.section_count] = bdos_state.data();
+        header.sections[header.section_count++] = {SECTION_BDOS, 0, offset, bdos_state.size()};
+        offset += bdos_state.size();
+    }
+
+    std::vector<uint8_t> image(offset);
+    memcpy(image.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < header.section_count; i++){
+        memcpy(image.data() + header.sections[i].offset, data[i], header.sections[i].size);
+    }
+    return image;
+}
+
+// Nothing has run or been written since the last capture or restore
+static bool atCheckpoint(Cpu* cpu){
+    if (cpu->tick != cpu->checkpoint_tick || cpu->bus->modified() || (cpu->mmu != nullptr && cpu->mmu->modified())){
+        return false;
+    }
+    for (uint64_t word : cpu->dirty_pages){
+        if (word != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+void Snapshot::restore(Cpu* cpu, const uint8_t* image, size_t size){
+    auto header = reinterpret_cast<const Header*>(image);
+    if (size < sizeof(Header) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+            || header->version < MIN_VERSION || header->version > VERSION || header->section_count > MAX_SECTIONS){
+        throw std::runtime_error("Invalid snapshot");
+    }
+    for (uint32_t i = 0; i < header->section_count; i++){
+        const Section& section = header->sections[i];
+        if (section.offset + section.size > size){
+            throw std::runtime_error("Truncated snapshot");
+        }
+    }
+    if (! cpu->io_map.snapshotSafe()){
+        throw std::runtime_error(DEVICES_ERROR);
+    }
+    if ((header->flags & FLAG_DELTA) && (header->base_tick != cpu->checkpoint_tick || ! atCheckpoint(cpu))){
+        throw std::runtime_error("Snapshot delta does not follow the current checkpoint");
+    }
+
+    if (header->version < 3 && cpu->mmu != nullptr){
+        throw std::runtime_error("Snapshot predates banked memory");
+    }
+    // Memory sections go to the memory model the machine was saved with
+    for (uint32_t i = 0; i < header->section_count; i++){
+        uint32_t type = header->sections[i].type;
+        if (type == SECTION_BANKED_MEMORY && cpu->mmu == nullptr){
+            throw std::runtime_error("Snapshot needs an MMU");
+        }
+        if ((type == SECTION_MEMORY || type == SECTION_MEMORY_PAGES) && cpu->mmu != nullptr){
+            throw std::runtime_error("Snapshot has no banked memory");
+        }
+    }
+
+    // Every section is checked before anything changes, so a bad snapshot leaves the machine as it was
+    for (uint32_t i = 0; i < header->section_count; i++){
+        const Section& section = header->sections[i];
+        const uint8_t* in = image + section.offset;
+        switch (section.type){
+            case SECTION_MEMORY_PAGES:
+                checkPages(in, section.size);
+                break;
+            case SECTION_BANKED_MEMORY:
+                cpu->mmu->checkState(in, section.size);
+                break;
+            case SECTION_BUS:
+                cpu->bus->checkState(in, section.size);
+                break;
+            case SECTION_BDOS:
+                Bdos::checkState(in, section.size);
+                break;
+            default:
+                break;
+        }
+    }
+
+    loadRegisters(cpu, &header->registers);
+
+    for (uint32_t i = 0; i < header->section_count; i++){
+        const Section& section = header->sections[i];
+        switch (section.type){
+            case SECTION_MEMORY:
+                memcpy(cpu->virtual_memory.data(), image + section.offset,
+                       std::min<uint64_t>(section.size, cpu->virtual_memory.size()));
+                break;
+            case SECTION_MEMORY_PAGES:
+                loadPages(cpu->virtual_memory.data(), image + section.offset, section.size);
+                break;
+            case SECTION_BANKED_MEMORY:
+                cpu->mmu->loadState(image + section.offset, section.size);
+                break;
+            case SECTION_BUS:
+                cpu->bus->loadState(image + section.offset, section.size);
+                break;
+            case SECTION_BDOS:
+                // Without an emulated BDOS there are no files to reopen
+                if (cpu->bdos != nullptr){
+                    cpu->bdos->loadState(image + section.offset, section.size);
+                }
+                break;
+            default:
+                // Written by a newer version. Skip it.
+                break;
+        }
+    }
+    cpu->dirty_pages.fill(0);
+    cpu->checkpoint_tick = cpu->tick;
+}
+
+static void writeFile(const char* path, const std::vector<uint8_t>& image){
+    FILE* fp = fopen(path, "wb");
+    if (fp == nullptr){
+        throw std::runtime_error("Cannot create snapshot");
+    }
+    bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+    if (fclose(fp) != 0 || ! ok){
+        throw std::runtime_error("Cannot write snapshot");
+    }
+}
+
+void Snapshot::save(Cpu* cpu, const char* path){
+    writeFile(path, capture(cpu, false));
+}
+
+void Snapshot::saveDelta(Cpu* cpu, const char* path){
+    writeFile(path, capture(cpu, true));
+}
+
+void Snapshot::load(Cpu* cpu, const char* path){
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        throw std::runtime_error("Cannot open snapshot");
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(Header)){
+        close(fd);
+        throw std::runtime_error("Invalid snapshot");
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED){
+        throw std::runtime_error("Cannot map snapshot");
+    }
+    try {
+        restore(cpu, static_cast<const uint8_t*>(addr), st.st_size);
+    } catch (...){
+        munmap(addr, st.st_size);
+        throw;
+    }
+    munmap(addr, st.st_size);
+}
+
+bool Snapshot::isSnapshot(const char* path){
+    char magic[sizeof(MAGIC)] = {};
+    FILE* fp = fopen(path, "rb");
+    if (fp == nullptr){
+        return false;
+    }
+    size_t size = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return size == sizeof(magic) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void Snapshot::savePages(const uint8_t* memory, const PageBitmap* dirty, std::vector<uint8_t>& out){
+    PageBitmap pages{};
+    if (dirty == nullptr){
+        pages.fill(~(uint64_t)0);
+    } else {
+        pages = *dirty;
+    }
+
+    size_t count = 0;
+    for (uint64_t word : pages){
+        count += __builtin_popcountll(word);
+    }
+    size_t start = out.size();
+    out.resize(start + sizeof(pages) + count * MEMORY_PAGE_SIZE);
+    uint8_t* p = out.data() + start;
+    memcpy(p, pages.data(), sizeof(pages));
+    p += sizeof(pages);
+
+    for (size_t w = 0; w < pages.size(); w++){
+        uint64_t word = pages[w];
+        while (word != 0){
+            size_t page = w * 64 + __builtin_ctzll(word);
+            memcpy(p, memory + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE);
+            p += MEMORY_PAGE_SIZE;
+            word &= word - 1;
+        }
+    }
+}
+
+size_t Snapshot::checkPages(const uint8_t* in, size_t size){
+    PageBitmap pages{};
+    if (size < sizeof(pages)){
+        throw std::runtime_error("Truncated snapshot");
+    }
+    memcpy(pages.data(), in, sizeof(pages));
+    size_t count = 0;
+    for (uint64_t word : pages){
+        count += __builtin_popcountll(word);
+    }
+    if (size < sizeof(pages) + count * MEMORY_PAGE_SIZE){
+        throw std::runtime_error("Truncated snapshot");
+    }
+    return sizeof(pages) + count * MEMORY_PAGE_SIZE;
+}
+
+size_t Snapshot::loadPages(uint8_t* memory, const uint8_t* in, size_t size){
+    checkPages(in, size);
+    PageBitmap pages{};
+    memcpy(pages.data(), in, sizeof(pages));
+    const uint8_t* p = in + sizeof(pages);
+
+    for (size_t w = 0; w < pages.size(); w++){
+        uint64_t word = pages[w];
+        while (word != 0){
+            size_t page = w * 64 + __builtin_ctzll(word);
+            memcpy(memory + page * MEMORY_PAGE_SIZE, p, MEMORY_PAGE_SIZE);
+            p += MEMORY_PAGE_SIZE;
+            word &= word - 1;
+        }
+    }
+    return p - in;
+}
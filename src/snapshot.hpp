@@ -0,0 +1,93 @@
+#ifndef Z80EMU_SNAPSHOT_HPP
+#define Z80EMU_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bus/bus.hpp"
+
+class Cpu;
+
+// Binary machine snapshot.
+//
+// An image is a fixed header followed by sections. A full image holds the whole machine and
+// every section starts on a page boundary, so a loader can mmap the file and use the memory
+// image in place. A delta image holds only the pages written since the previous checkpoint and
+// applies on top of the machine state at base_tick. Fields are stored in host (little-endian)
+// byte order.
+//
+// Machines with I/O devices other than the MMU cannot be captured or restored: the devices'
+// registers, their pending scheduler events and host side effects are not in the image.
+class Snapshot {
+public:
+    static const uint32_t VERSION = 3;
+    // Oldest version restore() takes. Version 2 has neither banked memory nor the BDOS.
+    static const uint32_t MIN_VERSION = 2;
+    static const uint32_t PAGE_SIZE = 4096;
+    static const uint32_t MEMORY_PAGE_SIZE = 256;
+    static const uint32_t MAX_SECTIONS = 5;
+
+    static const uint32_t FLAG_DELTA = 1;
+
+    static const uint32_t SECTION_MEMORY = 1;
+    static const uint32_t SECTION_BUS = 2;
+    static const uint32_t SECTION_MEMORY_PAGES = 3;
+    // Window registers and backing store of an Mmu, full or delta
+    static const uint32_t SECTION_BANKED_MEMORY = 4;
+    // DMA address, drive, user and open files of the emulated BDOS. Always in full.
+    static const uint32_t SECTION_BDOS = 5;
+
+    struct Registers {
+        uint16_t af, bc, de, hl;
+        uint16_t af_alt, bc_alt, de_alt, hl_alt;
+        uint16_t ix, iy, sp, pc;
+        uint8_t i, r;
+        uint8_t iff1, iff2;
+        uint8_t interrupt_mode;
+        uint8_t halt;
+        uint8_t waiting_ei, waiting_di;
+        uint8_t executing;
+        uint8_t stopped;
+        uint8_t enable_virtual_memory;
+        uint8_t emulate_cpm_bdos_call;
+        uint64_t tick;
+        uint64_t instructions;
+    };
+
+    struct Section {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        // Delta images: tick of the checkpoint they apply to
+        uint64_t base_tick;
+        uint32_t section_count;
+        uint32_t reserved;
+        Registers registers;
+        Section sections[MAX_SECTIONS];
+    };
+
+    // Serialises the machine. A delta holds the pages dirtied since the previous capture.
+    // Both kinds start a new dirty interval.
+    static std::vector<uint8_t> capture(Cpu* cpu, bool delta);
+    static void restore(Cpu* cpu, const uint8_t* image, size_t size);
+
+    static void save(Cpu* cpu, const char* path);
+    static void saveDelta(Cpu* cpu, const char* path);
+    static void load(Cpu* cpu, const char* path);
+    static bool isSnapshot(const char* path);
+
+    // Page bitmap followed by the selected pages. All pages when dirty is null.
+    static void savePages(const uint8_t* memory, const PageBitmap* dirty, std::vector<uint8_t>& out);
+    static size_t loadPages(uint8_t* memory, const uint8_t* in, size_t size);
+    // Size of the pages loadPages would read. Throws when they are truncated.
+    static size_t checkPages(const uint8_t* in, size_t size);
+};
+
+#endif //Z80EMU_SNAPSHOT_HPP
@@ -1,6 +1,7 @@
 #ifndef Z80EMU_SPECIAL_REGISTERS_HPP
 #define Z80EMU_SPECIAL_REGISTERS_HPP
 #include <cstdint>
+#include "registers.hpp"
 
 class SpecialRegisters {
 public:
@@ -8,17 +9,24 @@ public:
     uint8_t r = 0;
     uint16_t sp = 0;
     uint16_t pc = 0;
-    uint16_t ix = 0;
-    uint16_t iy = 0;
+    // Halves laid out as in Registers, which checks the host byte order
+    union {
+        uint16_t ix = 0;
+        struct { uint8_t ix_low; uint8_t ix_high; };
+    };
+    union {
+        uint16_t iy = 0;
+        struct { uint8_t iy_low; uint8_t iy_high; };
+    };
 
-    void ixh(uint8_t value);
-    [[nodiscard]] uint8_t ixh() const;
-    void ixl(uint8_t value);
-    [[nodiscard]] uint8_t ixl() const;
-    void iyh(uint8_t value);
-    [[nodiscard]] uint8_t iyh() const;
-    void iyl(uint8_t value);
-    [[nodiscard]] uint8_t iyl() const;
+    void ixh(uint8_t value){ this->ix_high = value; }
+    [[nodiscard]] uint8_t ixh() const{ return this->ix_high; }
+    void ixl(uint8_t value){ this->ix_low = value; }
+    [[nodiscard]] uint8_t ixl() const{ return this->ix_low; }
+    void iyh(uint8_t value){ this->iy_high = value; }
+    [[nodiscard]] uint8_t iyh() const{ return this->iy_high; }
+    void iyl(uint8_t value){ this->iy_low = value; }
+    [[nodiscard]] uint8_t iyl() const{ return this->iy_low; }
 };
 
 
@@ -0,0 +1,389 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "cpu.hpp"
+#include "cpm.hpp"
+#include "bdos.hpp"
+#include "console.hpp"
+#include "sio.hpp"
+#include "ctc.hpp"
+#include "disk.hpp"
+#include "mmu.hpp"
+#include "dma.hpp"
+#include "snapshot.hpp"
+#include "reverse.hpp"
+#include "gdbstub.hpp"
+#include "bus/simulated_bus.hpp"
+
+// Runs a CP/M .COM from host memory until it warm boots.
+// Lines ending in "OK" or containing "ERROR" (ZEXDOC/ZEXALL style) are reported as test groups.
+
+// Clock of the board the SIO baud rate is paced against
+static const uint32_t SIO_CLOCK_HZ = 4000000;
+
+struct TestGroup {
+    std::string name;
+    bool passed;
+    uint64_t tstates;
+    double seconds;
+};
+
+static std::string groupName(const std::string& line){
+    size_t end = line.find("..");
+    if (end == std::string::npos){
+        end = line.find("  ");
+    }
+    return line.substr(0, end);
+}
+
+int main(int argc, char* argv[]){
+    std::vector<const char*> paths;
+    uint64_t max_tstates = 0;
+    uint64_t snapshot_at = 0;
+    const char* snapshot_path = nullptr;
+    uint64_t checkpoint_every = 0;
+    const char* checkpoint_prefix = nullptr;
+    int last_write = -1;
+    const char* gdb_address = nullptr;
+    const char* directory = nullptr;
+    bool pty = false;
+    const char* console_ports = nullptr;
+    int sio_base = -1;
+    uint32_t sio_baud = 0;
+    int ctc_base = -1;
+    const char* disk_path = nullptr;
+    uint8_t disk_base = 0x10;
+    const char* mmu_spec = nullptr;
+    int dma_port = -1;
+    uint64_t realtime_hz = 0;
+    bool idle = false;
+    std::vector<const char*> watches;
+    bool quiet = false;
+    const char* log_path = nullptr;
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--max-tstates") == 0 && i + 1 < argc){
+            max_tstates = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--snapshot-at") == 0 && i + 2 < argc){
+            snapshot_at = strtoull(argv[++i], nullptr, 0);
+            snapshot_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 2 < argc){
+            checkpoint_every = strtoull(argv[++i], nullptr, 0);
+            checkpoint_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--last-write") == 0 && i + 1 < argc){
+            last_write = (int)(strtoul(argv[++i], nullptr, 0) & 0xffff);
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc){
+            watches.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--pty") == 0){
+            pty = true;
+        } else if (strcmp(argv[i], "--console-ports") == 0 && i + 1 < argc){
+            console_ports = argv[++i];
+        } else if (strcmp(argv[i], "--sio") == 0 && i + 1 < argc){
+            sio_base = (int)(strtoul(argv[++i], nullptr, 0) & 0xff);
+        } else if (strcmp(argv[i], "--sio-baud") == 0 && i + 1 < argc){
+            sio_baud = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--ctc") == 0 && i + 1 < argc){
+            ctc_base = (int)(strtoul(argv[++i], nullptr, 0) & 0xff);
+        } else if (strcmp(argv[i], "--disk") == 0 && i + 1 < argc){
+            disk_path = argv[++i];
+        } else if (strcmp(argv[i], "--disk-base") == 0 && i + 1 < argc){
+            disk_base = (uint8_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--mmu") == 0 && i + 1 < argc){
+            mmu_spec = argv[++i];
+        } else if (strcmp(argv[i], "--dma") == 0 && i + 1 < argc){
+            dma_port = (int)(strtoul(argv[++i], nullptr, 0) & 0xff);
+        } else if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc){
+            realtime_hz = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--idle") == 0){
+            idle = true;
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc){
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc){
+            gdb_address = argv[++i];
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc){
+            log_path = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0){
+            quiet = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()){
+        fprintf(stderr, "usage: z80cpm [--quiet] [--log file] [--max-tstates N] [--snapshot-at N file]\n"
+                        "              [--checkpoint-every N prefix] [--last-write addr] [--gdb port|socket]\n"
+                        "              [--watch addr[+length][:rwx]] [--dir directory]\n"
+                        "              [--pty] [--console-ports data,status] [--sio base] [--sio-baud N]\n"
+                        "              [--ctc base] [--disk image] [--disk-base port] [--mmu base[,size[,page]]]\n"
+                        "              [--dma port] [--realtime clock_hz] [--idle]\n"
+                        "              program.com [arguments...] | snapshot [delta...]\n");
+        return 2;
+    }
+
+    SimulatedBus bus;
+    Cpu cpu(&bus);
+    // Disk files live in the host directory
+    Bdos bdos(directory != nullptr ? directory : ".");
+    cpu.bdos = &bdos;
+    // Nothing drives the pins of the simulated bus. Emulated devices interrupt through io_map.
+    cpu.setPinPolling(0);
+    std::unique_ptr<Console> console;
+    std::unique_ptr<Console> serial;
+    std::unique_ptr<Sio> sio;
+    std::unique_ptr<IdeDisk> disk;
+    std::unique_ptr<Mmu> mmu;
+    try {
+        if (mmu_spec != nullptr){
+            // base[,size[,page]], 1MB in 16KB pages by default
+            char* end;
+            uint8_t mmu_base = (uint8_t)strtoul(mmu_spec, &end, 0);
+            size_t mmu_size = (*end == ',') ? strtoul(end + 1, &end, 0) : 0x100000;
+            size_t mmu_page = (*end == ',') ? strtoul(end + 1, nullptr, 0) : Mmu::DEFAULT_PAGE_SIZE;
+            mmu = std::make_unique<Mmu>(mmu_size, mmu_page);
+            mmu->attach(&cpu, mmu_base);
+        }
+        if (disk_path != nullptr){
+            disk = std::make_unique<IdeDisk>(disk_path);
+            disk->attach(&cpu.io_map, disk_base);
+        }
+        console.reset(pty ? Console::openPty() : new Console());
+        if (sio_base >= 0){
+            // Channel A on its own pty, channel B unconnected
+            serial.reset(Console::openPty());
+            sio = std::make_unique<Sio>(serial.get());
+        }
+    } catch (std::runtime_error& e){
+        fprintf(stderr, "z80cpm: %s\n", e.what());
+        return 2;
+    }
+    if (pty){
+        fprintf(stderr, "Console on %s\n", console->name().c_str());
+    }
+    if (console_ports != nullptr){
+        char* end;
+        console->data_port = (uint8_t)strtoul(console_ports, &end, 0);
+        console->status_port = (*end == ',') ? (uint8_t)strtoul(end + 1, nullptr, 0) : console->data_port + 1;
+        cpu.io_map.attach(console->data_port, console.get());
+        cpu.io_map.attach(console->status_port, console.get());
+    }
+    cpu.console = console.get();
+    console->scheduler = &cpu.scheduler;
+    if (serial){
+        serial->scheduler = &cpu.scheduler;
+    }
+    Dma dma;
+    if (dma_port >= 0){
+        dma.attach(&cpu, dma_port);
+    }
+    // The CTC comes first in the daisy chain
+    Ctc ctc;
+    if (ctc_base >= 0){
+        ctc.attach(&cpu, ctc_base);
+    }
+    if (sio){
+        sio->setBaud(sio_baud, SIO_CLOCK_HZ);
+        sio->attach(&cpu, sio_base);
+        fprintf(stderr, "SIO channel A on %s\n", serial->name().c_str());
+    }
+    // Snapshots leave out the state of the devices, so a restored run would not be the same
+    if (! cpu.io_map.snapshotSafe()
+            && (snapshot_path != nullptr || checkpoint_prefix != nullptr || last_write >= 0)){
+        fprintf(stderr, "z80cpm: --snapshot-at, --checkpoint-every and --last-write cannot be used with devices\n");
+        return 2;
+    }
+    // A snapshot may be followed by the deltas taken after it, applied in order
+    try {
+        if (Snapshot::isSnapshot(paths[0])){
+            for (const char* path : paths){
+                cpu.loadSnapshot(path);
+            }
+        } else {
+            // The rest of the command line is the command tail
+            std::string tail;
+            for (size_t i = 1; i < paths.size(); i++){
+                tail += (i > 1 ? " " : "") + std::string(paths[i]);
+            }
+            Cpm::load(&cpu, Cpm::readImage(paths[0]), tail.c_str());
+        }
+    } catch (std::runtime_error& e){
+        fprintf(stderr, "z80cpm: %s\n", e.what());
+        return 2;
+    }
+    for (const char* spec : watches){
+        // addr[+length][:rwx], logged to stderr on every hit
+        char* end;
+        uint16_t addr = (uint16_t)strtoul(spec, &end, 16);
+        uint16_t length = 1;
+        if (*end == '+'){
+            length = (uint16_t)strtoul(end + 1, &end, 0);
+        }
+        uint8_t type = Debug::WATCH_WRITE;
+        if (*end == ':'){
+            type = 0;
+            for (end++; *end != '\0'; end++){
+                type |= (*end == 'r') ? Debug::WATCH_READ : (*end == 'w') ? Debug::WATCH_WRITE
+                      : (*end == 'x') ? Debug::WATCH_EXECUTE : 0;
+            }
+        }
+        cpu.debug.addWatchpoint(addr, length, type, Debug::ACTION_LOG);
+    }
+    std::ofstream log;
+    if (log_path != nullptr){
+        log.open(log_path);
+        cpu.log_sink = &log;
+    }
+
+    if (realtime_hz > 0){
+        cpu.setRealtime(realtime_hz);
+    }
+    cpu.setIdleDetection(idle);
+    auto start = std::chrono::steady_clock::now();
+    auto group_start = start;
+    uint64_t group_tstates = 0;
+    std::vector<TestGroup> groups;
+    std::string line;
+
+    cpu.console_output = [&](uint8_t chr){
+        if (! quiet){
+            console->write(chr, cpu.tick);
+        }
+        if (chr == '\r'){
+            return;
+        }
+        if (chr != '\n'){
+            line += (char)chr;
+            return;
+        }
+        bool passed = (line.size() >= 2 && line.compare(line.size() - 2, 2, "OK") == 0);
+        bool failed = (line.find("ERROR") != std::string::npos);
+        if (passed || failed){
+            auto now = std::chrono::steady_clock::now();
+            groups.push_back({
+                    groupName(line),
+                    passed && !failed,
+                    cpu.tick - group_tstates,
+                    std::chrono::duration<double>(now - group_start).count(),
+            });
+            group_start = now;
+            group_tstates = cpu.tick;
+        }
+        line.clear();
+    };
+
+    // Recording history costs some speed, so only when it will be searched
+    std::unique_ptr<ReverseExecution> reverse;
+    if (gdb_address != nullptr && ! cpu.io_map.snapshotSafe()){
+        fprintf(stderr, "z80cpm: reverse execution is off with devices attached\n");
+    } else if (last_write >= 0 || gdb_address != nullptr){
+        reverse = std::make_unique<ReverseExecution>(&cpu);
+    }
+
+    int status = 0;
+    uint64_t next_checkpoint = cpu.tick;
+    int checkpoints = 0;
+    // Deltas follow the last capture, so a --snapshot-at image in between restarts the chain
+    bool full_checkpoint = true;
+    // Skipped halts and idle loops stop at these T-states, as if run instruction by instruction
+    auto stopAt = [&cpu](uint64_t when){ cpu.scheduler.post(when, [](uint64_t){}); };
+    if (max_tstates > 0){
+        stopAt(max_tstates);
+    }
+    if (snapshot_path != nullptr){
+        stopAt(snapshot_at);
+    }
+    try {
+        if (gdb_address != nullptr){
+            // Runs under the debugger until it detaches, then carries on below
+            GdbStub gdb(&cpu, reverse.get());
+            gdb.listen(gdb_address);
+            gdb.run();
+        }
+        while (! cpu.stopped){
+            if (max_tstates > 0 && cpu.tick >= max_tstates){
+                fprintf(stderr, "z80cpm: T-state budget exhausted at pc:%04x\n", cpu.special_registers.pc);
+                status = 2;
+                break;
+            }
+            if (snapshot_path != nullptr && cpu.tick >= snapshot_at){
+                cpu.saveSnapshot(snapshot_path);
+                snapshot_path = nullptr;
+                full_checkpoint = true;
+            }
+            if (checkpoint_prefix != nullptr && cpu.tick >= next_checkpoint){
+                // A full snapshot starts the chain, the rest are deltas on top of it. Loading every
+                // file in order still works when the chain restarts: a full image needs no base.
+                char checkpoint_path[1024];
+                snprintf(checkpoint_path, sizeof(checkpoint_path), "%s-%04d.snap", checkpoint_prefix, checkpoints++);
+                if (full_checkpoint){
+                    cpu.saveSnapshot(checkpoint_path);
+                    full_checkpoint = false;
+                } else {
+                    cpu.saveSnapshotDelta(checkpoint_path);
+                }
+                next_checkpoint = cpu.tick + checkpoint_every;
+                stopAt(next_checkpoint);
+            }
+            if (reverse){
+                reverse->step();
+            } else {
+                cpu.step();
+            }
+        }
+    } catch (std::runtime_error& e){
+        fprintf(stderr, "z80cpm: %s at pc:%04x\n", e.what(), cpu.special_registers.pc);
+        status = 2;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    console->flush();
+    if (serial){
+        serial->flush();
+    }
+
+    int failed = 0;
+    printf("\n");
+    for (auto& group : groups){
+        printf("%-4s %-40s %8.3lf s %10.3lf MHz\n",
+               group.passed ? "PASS" : "FAIL",
+               group.name.c_str(),
+               group.seconds,
+               group.seconds > 0 ? group.tstates / group.seconds / 1e6 : 0);
+        if (! group.passed){
+            failed++;
+        }
+    }
+    printf("%zu groups, %zu passed, %d failed\n", groups.size(), groups.size() - failed, failed);
+    printf("wall time: %.3lf s  instructions: %llu  T-states: %llu  emulated: %.3lf MHz\n",
+           seconds,
+           (unsigned long long)cpu.metrics.instructions,
+           (unsigned long long)cpu.tick,
+           seconds > 0 ? cpu.tick / seconds / 1e6 : 0);
+    if (idle){
+        printf("idle loops: %llu passes skipped, %llu host yields\n",
+               (unsigned long long)cpu.idle_loop.skipped_passes, (unsigned long long)cpu.idle_loop.yields);
+    }
+
+    if (last_write >= 0){
+        // Stops before the instruction that last changed the byte, so pc points at it
+        uint8_t value = cpu.memory(last_write);
+        uint64_t end = reverse->position();
+        bool found = reverse->reverseContinue([&](Cpu* c){ return c->memory(last_write) != value; });
+        if (found){
+            printf("last write to %04x (now %02x): pc:%04x instruction %llu T-state %llu\n",
+                   last_write, value, cpu.special_registers.pc,
+                   (unsigned long long)reverse->position(), (unsigned long long)cpu.tick);
+        } else {
+            printf("no write to %04x in the last %llu instructions\n",
+                   last_write, (unsigned long long)(end - reverse->start()));
+        }
+    }
+
+    if (status == 0 && failed > 0){
+        status = 1;
+    }
+    return status;
+}
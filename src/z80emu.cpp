@@ -1,11 +1,20 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <memory>
 #include <random>
+#include <string>
+#include <vector>
 #include <pigpio.h>
 #include "cpu.hpp"
 #include "mcycle.hpp"
 #include "log.hpp"
+#include "metrics.hpp"
+#include "gdbstub.hpp"
 #include "bus/pigpio_bus_bulk.hpp"
+#include "bus/bus_worker.hpp"
 
 void wait_nano_sec(int ns){
     struct timespec req{};
@@ -14,13 +23,97 @@ void wait_nano_sec(int ns){
     nanosleep(&req, nullptr);
 }
 
-int main(){
+// "from-to", both inclusive
+static bool parseRange(const char* text, uint16_t* from, uint16_t* to){
+    char* end = nullptr;
+    unsigned long first = strtoul(text, &end, 0);
+    if (*end != '-'){
+        return false;
+    }
+    unsigned long last = strtoul(end + 1, &end, 0);
+    if (*end != '\0' || first > last || last > 0xffff){
+        return false;
+    }
+    *from = (uint16_t)first;
+    *to = (uint16_t)last;
+    return true;
+}
+
+// "file[@addr]" into host memory
+static bool loadImage(Cpu* cpu, const char* spec){
+    std::string path = spec;
+    uint16_t addr = 0;
+    size_t at = path.rfind('@');
+    if (at != std::string::npos){
+        addr = (uint16_t)strtoul(path.c_str() + at + 1, nullptr, 0);
+        path.resize(at);
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (! file){
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    for (size_t i = 0; i < data.size() && addr + i <= 0xffff; i++){
+        cpu->memory((uint16_t)(addr + i)) = (uint8_t)data[i];
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
     printf("Hello z80\n");
 
     PigpioBusBulk bus = PigpioBusBulk();
     bus.syncControl();
     Cpu cpu(&bus);
+    std::ofstream log("log.txt");
+    cpu.log_sink = &log;
+    MetricsPublisher metrics;
+    cpu.metrics_publisher = &metrics;
+
+    // Hybrid mode: memory in host RAM, filled from images or from the board. Only I/O, interrupt
+    // acknowledge and the --mmio windows make bus cycles.
+    const char* gdb_address = nullptr;
+    std::unique_ptr<BusWorker> bus_worker;
+    for (int i = 1; i < argc; i++){
+        uint16_t from, to;
+        if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc){
+            gdb_address = argv[++i];
+        } else if (strcmp(argv[i], "--hybrid") == 0){
+            cpu.enable_virtual_memory = true;
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc){
+            if (! loadImage(&cpu, argv[++i])){
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--copy-board") == 0 && i + 1 < argc && parseRange(argv[i + 1], &from, &to)){
+            i++;
+            cpu.copyFromBus(from, (uint32_t)to - from + 1);
+        } else if (strcmp(argv[i], "--mmio") == 0 && i + 1 < argc && parseRange(argv[i + 1], &from, &to)){
+            i++;
+            cpu.mapToBus(from, to);
+        } else if (strcmp(argv[i], "--async-bus") == 0){
+            // Bus cycles from a second core, writes posted
+            bus_worker.reset(new BusWorker(&bus));
+            cpu.bus_worker = bus_worker.get();
+        } else if (strcmp(argv[i], "--pin-poll") == 0 && i + 1 < argc){
+            cpu.setPinPolling(strtoull(argv[++i], nullptr, 0));
+        } else {
+            fprintf(stderr, "usage: z80emu [--gdb port|socket] [--hybrid] [--image file[@addr]]\n"
+                            "              [--copy-board from-to] [--mmio from-to] [--pin-poll tstates]\n"
+                            "              [--async-bus]\n");
+            return 2;
+        }
+    }
+    if (cpu.has_bus_pages && ! cpu.enable_virtual_memory){
+        fprintf(stderr, "--mmio needs --hybrid\n");
+        return 2;
+    }
 
+    if (gdb_address != nullptr){
+        GdbStub gdb(&cpu);
+        gdb.listen(gdb_address);
+        gdb.run();
+    }
     cpu.instructionCycle();
     return 0;
 
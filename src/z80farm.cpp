@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "farm.hpp"
+
+// Runs a list of CP/M jobs in parallel.
+// Each line of the job file is: image.com budget [command tail]. A budget of 0 means unlimited.
+
+static bool readJobs(const char* path, std::vector<FarmJob>& jobs){
+    std::ifstream file(path);
+    if (! file){
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)){
+        std::istringstream fields(line);
+        FarmJob job;
+        std::string budget;
+        if (! (fields >> job.image_path) || job.image_path[0] == '#'){
+            continue;
+        }
+        if (fields >> budget){
+            job.budget = strtoull(budget.c_str(), nullptr, 0);
+        }
+        std::getline(fields >> std::ws, job.input);
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    const char* jobs_path = nullptr;
+    const char* output_dir = nullptr;
+    unsigned int threads = 0;
+    uint64_t slice = Farm::DEFAULT_SLICE;
+    bool idle = false;
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc){
+            threads = strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc){
+            slice = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+            output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--idle") == 0){
+            idle = true;
+        } else {
+            jobs_path = argv[i];
+        }
+    }
+    if (jobs_path == nullptr || slice == 0){
+        fprintf(stderr, "usage: z80farm [-j threads] [--slice tstates] [--idle] [-o output_dir] jobs.txt\n");
+        return 2;
+    }
+
+    std::vector<FarmJob> jobs;
+    if (! readJobs(jobs_path, jobs)){
+        fprintf(stderr, "z80farm: cannot read %s\n", jobs_path);
+        return 2;
+    }
+
+    Farm farm(threads, slice);
+    farm.idle_detection = idle;
+    farm.run(jobs);
+
+    int failed = 0;
+    for (size_t i = 0; i < jobs.size(); i++){
+        const FarmJob& job = jobs[i];
+        printf("%zu\t%s\t%s\tT-states:%llu\tinstructions:%llu%s%s\n",
+               i,
+               job.image_path.c_str(),
+               FarmJob::stateName(job.state),
+               (unsigned long long)job.tstates,
+               (unsigned long long)job.instructions,
+               job.error.empty() ? "" : "\t",
+               job.error.c_str());
+        if (job.state != FarmJob::FINISHED){
+            failed++;
+        }
+        if (output_dir != nullptr){
+            std::ofstream out(std::string(output_dir) + "/" + std::to_string(i) + ".txt", std::ios::binary);
+            out << job.output;
+        }
+    }
+    printf("%zu jobs, %zu finished, %d not finished\n", jobs.size(), jobs.size() - failed, failed);
+    return (failed > 0) ? 1 : 0;
+}
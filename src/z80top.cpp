@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <unistd.h>
+#include "metrics.hpp"
+
+int main(int argc, char* argv[]){
+    const char* name = (argc > 1) ? argv[1] : MetricsPublisher::DEFAULT_NAME;
+
+    const MetricsPage* page = MetricsPublisher::attach(name);
+    if (page == nullptr){
+        fprintf(stderr, "z80top: no metrics page at %s\n", name);
+        return 1;
+    }
+
+    static const char* mcycle_names[Metrics::MCYCLE_TYPES] = {
+            "M1", "MEM read", "MEM write", "IO read", "IO write", "INT ack", "HALT",
+    };
+
+    while (true){
+        MetricsSample sample{};
+        if (! MetricsPublisher::read(page, &sample)){
+            sleep(1);
+            continue;
+        }
+
+        double halted = (sample.tstates > 0) ? 100.0 * sample.halted_tstates / sample.tstates : 0;
+        printf("\x1b[H\x1b[2J");
+        printf("z80top  %s  pid:%u\n\n", name, page->pid);
+        printf("instructions/sec  %14.0lf\n", sample.instructions_per_sec);
+        printf("T-states/sec      %14.0lf  (%.3lf MHz)\n", sample.tstates_per_sec, sample.tstates_per_sec / 1e6);
+        printf("instructions      %14llu\n", (unsigned long long)sample.instructions);
+        printf("T-states          %14llu\n\n", (unsigned long long)sample.tstates);
+        for (int i = 0; i < Metrics::MCYCLE_TYPES; i++){
+            printf("%-17s %14llu\n", mcycle_names[i], (unsigned long long)sample.mcycles[i]);
+        }
+        printf("\nWAIT T-states     %14llu\n", (unsigned long long)sample.wait_cycles);
+        printf("NMI taken         %14llu\n", (unsigned long long)sample.nmi_taken);
+        printf("INT taken         %14llu\n", (unsigned long long)sample.int_taken);
+        printf("halted            %14llu  (%.1lf%%)\n", (unsigned long long)sample.halted_tstates, halted);
+        printf("bus released      %14llu  (%llu T-states)\n", (unsigned long long)sample.bus_releases,
+               (unsigned long long)sample.busack_tstates);
+        printf("trace drops       %14llu\n", (unsigned long long)sample.trace_drops);
+        fflush(stdout);
+
+        sleep(1);
+    }
+}